@@ -11,13 +11,189 @@
 #include <inttypes.h>
 
 #include <gc/gc.h>
+#include <gc/gc_typed.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 
 const char **zion_argv;
 int64_t zion_argc;
 
+void *zion_hash_use_keyed();
+static void zion_select_simd();
+
+/* collector timings, in microseconds.
+ *
+ * a pause is time the program cannot run: from GC_EVENT_PRE_STOP_WORLD to
+ * GC_EVENT_POST_START_WORLD, plus the reclaim phase that follows while the
+ * collector still holds the allocation lock. collectors built without thread
+ * support never stop the world, so for them the mark phase stands in for it.
+ * the small mark steps an incremental collector takes during allocation send
+ * no events and are not counted.
+ *
+ * a cycle is a whole collection, GC_EVENT_START to GC_EVENT_END. in
+ * incremental mode that includes all the marking interleaved with the
+ * program, so it says nothing about pause lengths. */
+static int64_t zion_gc_pause_start;
+static int zion_gc_stops_world;
+static int64_t zion_gc_last_pause;
+static int64_t zion_gc_max_pause;
+static int64_t zion_gc_total_pause;
+static int64_t zion_gc_pauses;
+static int64_t zion_gc_cycle_start;
+static int64_t zion_gc_last_cycle;
+static int64_t zion_gc_total_cycle;
+
+static int64_t zion_monotonic_micros() {
+  struct timespec spec;
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+  return (int64_t)spec.tv_sec * 1000000 + spec.tv_nsec / 1000;
+}
+
+static void zion_gc_start_pause() {
+  zion_gc_pause_start = zion_monotonic_micros();
+}
+
+static void zion_gc_end_pause() {
+  zion_gc_last_pause = zion_monotonic_micros() - zion_gc_pause_start;
+  zion_gc_total_pause += zion_gc_last_pause;
+  ++zion_gc_pauses;
+  if (zion_gc_last_pause > zion_gc_max_pause) {
+    zion_gc_max_pause = zion_gc_last_pause;
+  }
+}
+
+static void zion_gc_extend_pause() {
+  /* the reclaim phase belongs to the pause that just ended */
+  int64_t reclaim = zion_monotonic_micros() - zion_gc_pause_start;
+  zion_gc_last_pause += reclaim;
+  zion_gc_total_pause += reclaim;
+  if (zion_gc_last_pause > zion_gc_max_pause) {
+    zion_gc_max_pause = zion_gc_last_pause;
+  }
+}
+
+static void zion_gc_on_collection_event(GC_EventType event) {
+  /* runs with the allocation lock held, so it must not allocate */
+  switch (event) {
+  case GC_EVENT_START:
+    zion_gc_cycle_start = zion_monotonic_micros();
+    break;
+  case GC_EVENT_END:
+    zion_gc_last_cycle = zion_monotonic_micros() - zion_gc_cycle_start;
+    zion_gc_total_cycle += zion_gc_last_cycle;
+    break;
+  case GC_EVENT_PRE_STOP_WORLD:
+    zion_gc_stops_world = 1;
+    zion_gc_start_pause();
+    break;
+  case GC_EVENT_POST_START_WORLD:
+    zion_gc_end_pause();
+    break;
+  case GC_EVENT_MARK_START:
+    if (!zion_gc_stops_world) {
+      zion_gc_start_pause();
+    }
+    break;
+  case GC_EVENT_MARK_END:
+    if (!zion_gc_stops_world) {
+      zion_gc_end_pause();
+    }
+    break;
+  case GC_EVENT_RECLAIM_START:
+    zion_gc_start_pause();
+    break;
+  case GC_EVENT_RECLAIM_END:
+    zion_gc_extend_pause();
+    break;
+  default:
+    break;
+  }
+}
+
+/* reads a byte count such as "4096", "512k", "64m" or "1g" from the
+ * environment, returning 0 if it is not set */
+static size_t zion_getenv_bytes(const char *name) {
+  const char *value = getenv(name);
+  if (value == NULL) {
+    return 0;
+  }
+  char *suffix = NULL;
+  size_t cb = strtoull(value, &suffix, 10);
+  switch (*suffix) {
+  case 'g':
+  case 'G':
+    cb *= 1024;
+    /* fall through */
+  case 'm':
+  case 'M':
+    cb *= 1024;
+    /* fall through */
+  case 'k':
+  case 'K':
+    cb *= 1024;
+  }
+  return cb;
+}
+
+/* collector tuning. the defaults can be baked in at build time by passing
+ * e.g. -DZION_GC_DEFAULT_MARKERS=4 in $ZION_OPT_FLAGS, and overridden at run
+ * time with the matching ZION_GC_* environment variable. zero leaves the
+ * collector's own default in place. */
+#ifndef ZION_GC_DEFAULT_MARKERS
+#define ZION_GC_DEFAULT_MARKERS 0
+#endif
+#ifndef ZION_GC_DEFAULT_INCREMENTAL
+#define ZION_GC_DEFAULT_INCREMENTAL 0
+#endif
+#ifndef ZION_GC_DEFAULT_FREE_SPACE_DIVISOR
+#define ZION_GC_DEFAULT_FREE_SPACE_DIVISOR 0
+#endif
+
+static long zion_getenv_long(const char *name, long default_value) {
+  const char *value = getenv(name);
+  return value != NULL ? atol(value) : default_value;
+}
+
 void zion_init(int argc, const char *argv[]) {
+	/* parallel marking has to be configured before the collector starts */
+	long markers = zion_getenv_long("ZION_GC_MARKERS", ZION_GC_DEFAULT_MARKERS);
+	if (markers > 0) {
+		GC_set_markers_count((unsigned)markers);
+	}
+
 	/* initialize the collector */
 	GC_INIT();
+	GC_set_on_collection_event(zion_gc_on_collection_event);
+
+	/* a larger divisor collects more often in exchange for a smaller heap */
+	long free_space_divisor = zion_getenv_long(
+		"ZION_GC_FREE_SPACE_DIVISOR", ZION_GC_DEFAULT_FREE_SPACE_DIVISOR);
+	if (free_space_divisor > 0) {
+		GC_set_free_space_divisor((GC_word)free_space_divisor);
+	}
+
+	/* incremental (and, where the platform supports dirty bits, generational)
+	 * collection trades throughput for shorter pauses */
+	if (zion_getenv_long("ZION_GC_INCREMENTAL", ZION_GC_DEFAULT_INCREMENTAL) !=
+	    0) {
+		GC_enable_incremental();
+	}
+
+	/* growing the heap up front avoids collecting over and over while a
+	 * program builds up its working set */
+	size_t initial_heap = zion_getenv_bytes("ZION_GC_INITIAL_HEAP");
+	if (initial_heap > GC_get_heap_size()) {
+		GC_expand_hp(initial_heap - GC_get_heap_size());
+	}
+
+	zion_select_simd();
+
+	const char *hash = getenv("ZION_HASH");
+	if (hash != NULL && strcmp(hash, "siphash") == 0) {
+		zion_hash_use_keyed();
+	}
 
 	zion_argc = argc;
 	zion_argv = argv;
@@ -72,6 +248,211 @@ int64_t zion_socket(int64_t domain, int64_t type, int64_t protocol) {
   return socket(domain, type, protocol);
 }
 
+/* String scanning kernels. On x86-64 the SSE2 versions are always available
+ * and zion_init picks wider ones when the CPU has them. ZION_SIMD can cap the
+ * choice, which is handy when comparing kernels or chasing a bug in one. */
+enum {
+  zion_simd_none,
+  zion_simd_sse2,
+  zion_simd_sse42,
+  zion_simd_avx2,
+};
+
+static int zion_simd_level = zion_simd_none;
+
+static void zion_select_simd() {
+#ifdef __x86_64__
+  int level = zion_simd_sse2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    level = zion_simd_sse42;
+    if (__builtin_cpu_supports("avx2")) {
+      level = zion_simd_avx2;
+    }
+  }
+  const char *cap = getenv("ZION_SIMD");
+  if (cap != NULL) {
+    int max_level = (strcmp(cap, "none") == 0)     ? zion_simd_none
+                    : (strcmp(cap, "sse2") == 0)   ? zion_simd_sse2
+                    : (strcmp(cap, "sse4.2") == 0) ? zion_simd_sse42
+                                                   : zion_simd_avx2;
+    if (level > max_level) {
+      level = max_level;
+    }
+  }
+  zion_simd_level = level;
+#endif
+}
+
+#define zion_fold_ascii(ch) \
+  ((ch) >= 'A' && (ch) <= 'Z' ? (ch) + ('a' - 'A') : (ch))
+
+#define zion_isspace_ascii(ch) ((ch) == ' ' || ((ch) >= '\t' && (ch) <= '\r'))
+
+/* Needles up to this long are found by filtering on their first and last
+ * bytes, which is quickest in practice but degrades with length on
+ * adversarial input. Longer ones use Two-Way, which is linear. */
+#define ZION_MEMMEM_SHORT_NEEDLE 32
+
+static const char *zion_memmem_short(const char *big,
+                                     int64_t big_len,
+                                     const char *little,
+                                     int64_t little_len) {
+  if (big_len < little_len) {
+    return NULL;
+  }
+  const char *end = big + big_len - little_len + 1;
+  while (big < end) {
+    big = memchr(big, little[0], end - big);
+    if (big == NULL) {
+      return NULL;
+    }
+    if (memcmp(big + 1, little + 1, little_len - 1) == 0) {
+      return big;
+    }
+    ++big;
+  }
+  return NULL;
+}
+
+/* Crochemore and Perrin's Two-Way algorithm: split the needle at a critical
+ * factorization, match the right half forwards and then the left half, and
+ * use the needle's period to skip ahead without ever backing up in big. */
+static size_t zion_maximal_suffix(const unsigned char *n,
+                                  size_t len,
+                                  size_t *period,
+                                  int reversed) {
+  size_t suffix = (size_t)-1;
+  size_t j = 0;
+  size_t k = 1;
+  size_t p = 1;
+  while (j + k < len) {
+    unsigned char a = n[suffix + k];
+    unsigned char b = n[j + k];
+    if (a == b) {
+      if (k == p) {
+        j += p;
+        k = 1;
+      } else {
+        ++k;
+      }
+    } else if (reversed ? a < b : a > b) {
+      j += k;
+      k = 1;
+      p = j - suffix;
+    } else {
+      suffix = j++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return suffix;
+}
+
+static const char *zion_memmem_two_way(const char *big,
+                                       int64_t big_len,
+                                       const char *little,
+                                       int64_t little_len) {
+  const unsigned char *h = (const unsigned char *)big;
+  const unsigned char *n = (const unsigned char *)little;
+  const size_t len = little_len;
+  const unsigned char *h_end = h + big_len;
+
+  size_t period, reversed_period;
+  size_t split = zion_maximal_suffix(n, len, &period, 0);
+  size_t reversed_split = zion_maximal_suffix(n, len, &reversed_period, 1);
+  if (reversed_split + 1 > split + 1) {
+    split = reversed_split;
+    period = reversed_period;
+  }
+
+  /* how much of the left half is known to match after a periodic shift */
+  size_t memory_after_shift;
+  if (memcmp(n, n + period, split + 1) != 0) {
+    memory_after_shift = 0;
+    period = (split > len - split - 1 ? split : len - split - 1) + 1;
+  } else {
+    memory_after_shift = len - period;
+  }
+
+  size_t memory = 0;
+  while ((size_t)(h_end - h) >= len) {
+    size_t k = split + 1 > memory ? split + 1 : memory;
+    while (k < len && n[k] == h[k]) {
+      ++k;
+    }
+    if (k < len) {
+      h += k - split;
+      memory = 0;
+      continue;
+    }
+    for (k = split + 1; k > memory && n[k - 1] == h[k - 1]; --k) {
+    }
+    if (k <= memory) {
+      return (const char *)h;
+    }
+    h += period;
+    memory = memory_after_shift;
+  }
+  return NULL;
+}
+
+#ifdef __x86_64__
+/* Wojciech Muła's SIMD-friendly search: compare a block of candidate starts
+ * against the needle's first byte and the block shifted by the needle's length
+ * against its last, and only memcmp where both agree. */
+static const char *zion_memmem_sse2(const char *big,
+                                    int64_t big_len,
+                                    const char *little,
+                                    int64_t little_len) {
+  const __m128i first = _mm_set1_epi8(little[0]);
+  const __m128i last = _mm_set1_epi8(little[little_len - 1]);
+  int64_t i = 0;
+  for (; i + 16 + little_len - 1 <= big_len; i += 16) {
+    __m128i block_first = _mm_loadu_si128((const __m128i *)(big + i));
+    __m128i block_last = _mm_loadu_si128(
+        (const __m128i *)(big + i + little_len - 1));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                      _mm_cmpeq_epi8(block_last, last)));
+    while (mask != 0) {
+      int bit = __builtin_ctz(mask);
+      if (memcmp(big + i + bit + 1, little + 1, little_len - 2) == 0) {
+        return big + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return zion_memmem_short(big + i, big_len - i, little, little_len);
+}
+
+__attribute__((target("avx2"))) static const char *zion_memmem_avx2(
+    const char *big,
+    int64_t big_len,
+    const char *little,
+    int64_t little_len) {
+  const __m256i first = _mm256_set1_epi8(little[0]);
+  const __m256i last = _mm256_set1_epi8(little[little_len - 1]);
+  int64_t i = 0;
+  for (; i + 32 + little_len - 1 <= big_len; i += 32) {
+    __m256i block_first = _mm256_loadu_si256((const __m256i *)(big + i));
+    __m256i block_last = _mm256_loadu_si256(
+        (const __m256i *)(big + i + little_len - 1));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+    while (mask != 0) {
+      int bit = __builtin_ctz(mask);
+      if (memcmp(big + i + bit + 1, little + 1, little_len - 2) == 0) {
+        return big + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return zion_memmem_short(big + i, big_len - i, little, little_len);
+}
+#endif
+
 const char *zion_memmem(const char *big,
                         int64_t big_len,
                         const char *little,
@@ -86,24 +467,322 @@ const char *zion_memmem(const char *big,
     return NULL;
   }
 
-  if (big_len == 0) {
-    return NULL;
+  if (little_len == 1) {
+    return memchr(big, *little, big_len);
+  } else if (little_len > ZION_MEMMEM_SHORT_NEEDLE) {
+    return zion_memmem_two_way(big, big_len, little, little_len);
+  }
+#ifdef __x86_64__
+  if (zion_simd_level >= zion_simd_avx2) {
+    return zion_memmem_avx2(big, big_len, little, little_len);
+  } else if (zion_simd_level >= zion_simd_sse2) {
+    return zion_memmem_sse2(big, big_len, little, little_len);
   }
+#endif
+  return zion_memmem_short(big, big_len, little, little_len);
+}
 
-  if (little_len == sizeof(char)) {
-    return memchr(big, *little, big_len);
-  } else {
-    const char *max_big = big + big_len - little_len + 1;
+#ifdef __x86_64__
+/* Finds the first byte of s in set (at most 16 bytes) with PCMPESTRI, looking
+ * at whole 16 byte blocks only. Sets *scanned to where the blocks ended. */
+__attribute__((target("sse4.2"))) static int64_t zion_find_any_of_sse42(
+    const char *s,
+    int64_t len,
+    const char *set,
+    int64_t set_len,
+    int64_t *scanned) {
+  char set_block[16] = {0};
+  memcpy(set_block, set, set_len);
+  const __m128i members = _mm_loadu_si128((const __m128i *)set_block);
+  int64_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+    int index = _mm_cmpestri(members, (int)set_len, block, 16,
+                             _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+                                 _SIDD_LEAST_SIGNIFICANT);
+    if (index < 16) {
+      return i + index;
+    }
+  }
+  *scanned = i;
+  return -1;
+}
+#endif
 
-    while (big < max_big) {
-      if (memcmp(big, little, little_len) == 0) {
-        return big;
-      }
-      ++big;
+/* Returns the index of the first byte of s that appears in set, or -1. */
+int64_t zion_find_any_of(const char *s,
+                         int64_t len,
+                         const char *set,
+                         int64_t set_len) {
+  if (set_len == 0) {
+    return -1;
+  } else if (set_len == 1) {
+    const char *found = memchr(s, set[0], len);
+    return found != NULL ? found - s : -1;
+  }
+
+  int64_t i = 0;
+#ifdef __x86_64__
+  if (zion_simd_level >= zion_simd_sse42 && set_len <= 16) {
+    int64_t found = zion_find_any_of_sse42(s, len, set, set_len, &i);
+    if (found != -1) {
+      return found;
     }
+  }
+#endif
 
-    return NULL;
+  uint64_t members[4] = {0, 0, 0, 0};
+  for (int64_t j = 0; j < set_len; ++j) {
+    unsigned char ch = set[j];
+    members[ch >> 6] |= (uint64_t)1 << (ch & 63);
+  }
+  for (; i < len; ++i) {
+    unsigned char ch = s[i];
+    if (members[ch >> 6] & ((uint64_t)1 << (ch & 63))) {
+      return i;
+    }
   }
+  return -1;
+}
+
+#ifdef __x86_64__
+static int64_t zion_count_char_sse2(const char *s,
+                                    int64_t len,
+                                    char ch,
+                                    int64_t *scanned) {
+  const __m128i needle = _mm_set1_epi8(ch);
+  int64_t count = 0;
+  int64_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+    count += __builtin_popcount(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+  }
+  *scanned = i;
+  return count;
+}
+
+__attribute__((target("avx2,popcnt"))) static int64_t zion_count_char_avx2(
+    const char *s,
+    int64_t len,
+    char ch,
+    int64_t *scanned) {
+  const __m256i needle = _mm256_set1_epi8(ch);
+  int64_t count = 0;
+  int64_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(s + i));
+    count += __builtin_popcount(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+  }
+  *scanned = i;
+  return count;
+}
+#endif
+
+int64_t zion_count_char(const char *s, int64_t len, char ch) {
+  int64_t count = 0;
+  int64_t i = 0;
+#ifdef __x86_64__
+  if (zion_simd_level >= zion_simd_avx2) {
+    count = zion_count_char_avx2(s, len, ch, &i);
+  } else if (zion_simd_level >= zion_simd_sse2) {
+    count = zion_count_char_sse2(s, len, ch, &i);
+  }
+#endif
+  for (; i < len; ++i) {
+    count += s[i] == ch;
+  }
+  return count;
+}
+
+#ifdef __x86_64__
+/* Lowercases the ASCII letters in a block, leaving every other byte alone.
+ * Adding 0x80 - 'A' moves 'A'..'Z' to the bottom of the signed range, where
+ * one compare picks them out. */
+static __m128i zion_fold_ascii_sse2(__m128i block) {
+  __m128i shifted = _mm_add_epi8(block, _mm_set1_epi8((char)(0x80 - 'A')));
+  __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + 26)));
+  return _mm_or_si128(block, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) static __m256i zion_fold_ascii_avx2(
+    __m256i block) {
+  __m256i shifted = _mm256_add_epi8(block,
+                                    _mm256_set1_epi8((char)(0x80 - 'A')));
+  __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)),
+                                    shifted);
+  return _mm256_or_si256(block,
+                         _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+static int64_t zion_fold_mismatch_sse2(const char *a,
+                                       const char *b,
+                                       int64_t len) {
+  int64_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = zion_fold_ascii_sse2(_mm_loadu_si128((const __m128i *)(a + i)));
+    __m128i y = zion_fold_ascii_sse2(_mm_loadu_si128((const __m128i *)(b + i)));
+    unsigned same = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+    if (same != 0xffff) {
+      return i + __builtin_ctz(~same);
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static int64_t zion_fold_mismatch_avx2(
+    const char *a,
+    const char *b,
+    int64_t len) {
+  int64_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = zion_fold_ascii_avx2(
+        _mm256_loadu_si256((const __m256i *)(a + i)));
+    __m256i y = zion_fold_ascii_avx2(
+        _mm256_loadu_si256((const __m256i *)(b + i)));
+    unsigned same = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+    if (same != 0xffffffff) {
+      return i + __builtin_ctz(~same);
+    }
+  }
+  return i;
+}
+#endif
+
+/* Compares a and b as strcmp would after lowercasing their ASCII letters. */
+int64_t zion_ascii_casecmp(const char *a,
+                           int64_t a_len,
+                           const char *b,
+                           int64_t b_len) {
+  int64_t len = a_len < b_len ? a_len : b_len;
+  int64_t i = 0;
+#ifdef __x86_64__
+  /* the vector loops stop at the first block that differs, so the scalar loop
+   * below finds the exact byte */
+  if (zion_simd_level >= zion_simd_avx2) {
+    i = zion_fold_mismatch_avx2(a, b, len);
+  } else if (zion_simd_level >= zion_simd_sse2) {
+    i = zion_fold_mismatch_sse2(a, b, len);
+  }
+#endif
+  for (; i < len; ++i) {
+    unsigned char x = a[i];
+    unsigned char y = b[i];
+    if (zion_fold_ascii(x) != zion_fold_ascii(y)) {
+      return (int64_t)zion_fold_ascii(x) - (int64_t)zion_fold_ascii(y);
+    }
+  }
+  return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+}
+
+/* Whitespace runs at the ends of a field are rarely longer than a few bytes,
+ * so these stay scalar. */
+int64_t zion_skip_space(const char *s, int64_t len) {
+  int64_t i = 0;
+  while (i < len && zion_isspace_ascii(s[i])) {
+    ++i;
+  }
+  return i;
+}
+
+int64_t zion_skip_space_back(const char *s, int64_t len) {
+  while (len > 0 && zion_isspace_ascii(s[len - 1])) {
+    --len;
+  }
+  return len;
+}
+
+#ifdef __x86_64__
+static int64_t zion_skip_ascii_sse2(const char *s, int64_t len) {
+  int64_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i))) != 0) {
+      break;
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static int64_t zion_skip_ascii_avx2(
+    const char *s,
+    int64_t len) {
+  int64_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i))) !=
+        0) {
+      break;
+    }
+  }
+  return i;
+}
+#endif
+
+/* Returns how many leading bytes of s are certainly ASCII. */
+static int64_t zion_skip_ascii(const char *s, int64_t len) {
+  int64_t i = 0;
+#ifdef __x86_64__
+  if (zion_simd_level >= zion_simd_avx2) {
+    i = zion_skip_ascii_avx2(s, len);
+  } else if (zion_simd_level >= zion_simd_sse2) {
+    i = zion_skip_ascii_sse2(s, len);
+  }
+#endif
+  while (i < len && (unsigned char)s[i] < 0x80) {
+    ++i;
+  }
+  return i;
+}
+
+/* Returns the index of the first byte of s that does not belong to a well
+ * formed UTF-8 sequence (overlong forms, surrogates and code points past
+ * U+10FFFF included), or -1 if s is valid UTF-8. Text is mostly ASCII, so
+ * the vector kernels skip ASCII runs and sequences are checked one by one. */
+int64_t zion_utf8_invalid_index(const char *s, int64_t len) {
+  const unsigned char *p = (const unsigned char *)s;
+  int64_t i = 0;
+  while (i < len) {
+    i += zion_skip_ascii(s + i, len - i);
+    if (i == len) {
+      break;
+    }
+    unsigned char lead = p[i];
+    int64_t trailing;
+    unsigned char min_second = 0x80;
+    unsigned char max_second = 0xbf;
+    if (lead < 0xc2) {
+      return i;
+    } else if (lead < 0xe0) {
+      trailing = 1;
+    } else if (lead < 0xf0) {
+      trailing = 2;
+      if (lead == 0xe0) {
+        min_second = 0xa0;
+      } else if (lead == 0xed) {
+        max_second = 0x9f;
+      }
+    } else if (lead < 0xf5) {
+      trailing = 3;
+      if (lead == 0xf0) {
+        min_second = 0x90;
+      } else if (lead == 0xf4) {
+        max_second = 0x8f;
+      }
+    } else {
+      return i;
+    }
+    if (i + trailing >= len || p[i + 1] < min_second ||
+        p[i + 1] > max_second) {
+      return i;
+    }
+    for (int64_t j = 2; j <= trailing; ++j) {
+      if ((p[i + j] & 0xc0) != 0x80) {
+        return i;
+      }
+    }
+    i += trailing + 1;
+  }
+  return -1;
 }
 
 const char *zion_strerror(int errnum, char *buf, int64_t bufsize) {
@@ -127,6 +806,192 @@ void *zion_malloc(uint64_t cb) {
   return pb;
 }
 
+/* generated code pops small objects off of these lists inline (see
+ * llvm_get_malloc_inline), and calls zion_malloc_refill when one runs dry.
+ * size class n holds objects of n granules. Zion programs are single-threaded,
+ * and keeping the lists in ordinary static data means the collector sees the
+ * objects on them as live. */
+#define ZION_GRANULE_SIZE 16
+#define ZION_SMALL_OBJECT_CLASSES 16
+
+void *zion_free_lists[ZION_SMALL_OBJECT_CLASSES + 1];
+
+void *zion_malloc_refill(uint64_t size_class) {
+  uint64_t cb = size_class * ZION_GRANULE_SIZE;
+  void *list = GC_malloc_many(cb);
+  if (list == NULL) {
+    return zion_malloc(cb);
+  }
+  /* GC_malloc_many clears everything but the link word */
+  zion_free_lists[size_class] = GC_NEXT(list);
+  GC_NEXT(list) = NULL;
+  return list;
+}
+
+void *zion_malloc_atomic(uint64_t cb) {
+  /* for memory that will never hold pointers into the heap. the collector
+   * does not scan it, and does not clear it for us. */
+  void *pb = GC_MALLOC_ATOMIC(cb);
+  if (pb != NULL) {
+    memset(pb, 0, cb);
+  }
+  return pb;
+}
+
+/* the compiler emits one of these for each tuple layout that mixes pointers
+ * with scalars. bit i of bitmap is set when word i holds a pointer. */
+struct zion_gc_layout {
+  GC_descr descr;
+  GC_word bitmap;
+  GC_word word_count;
+};
+
+void *zion_malloc_typed(uint64_t cb, struct zion_gc_layout *layout) {
+  /* descriptors can only be made once the collector is up, so make them
+   * lazily. a layout with pointers never gets a zero descriptor. */
+  if (layout->descr == 0) {
+    layout->descr = GC_make_descriptor(&layout->bitmap, layout->word_count);
+  }
+  return GC_MALLOC_EXPLICITLY_TYPED(cb, layout->descr);
+}
+
+/* programs built with ZION_ALLOC_PROFILE set call zion_alloc_profile ahead of
+ * each heap allocation with the name of the site making it, and bracket every
+ * call with zion_alloc_profile_enter and zion_alloc_profile_leave, so that
+ * the runtime knows which calls led to the allocation. allocations are tallied
+ * per site and stack of calls, and written to stderr at exit in folded stack
+ * format (outermost call first), weighted by bytes, or by allocation count
+ * when ZION_ALLOC_PROFILE=count. */
+
+/* how deep the stack of calls is followed; deeper calls keep their innermost
+ * frames */
+#define ZION_ALLOC_PROFILE_FRAMES 32
+#define ZION_ALLOC_PROFILE_MAX_DEPTH 65536
+#define ZION_ALLOC_PROFILE_BUCKETS 4096
+
+static const char *zion_alloc_call_sites[ZION_ALLOC_PROFILE_MAX_DEPTH];
+static int64_t zion_alloc_call_depth;
+
+struct zion_alloc_stack {
+  const char *site;
+  const char *frames[ZION_ALLOC_PROFILE_FRAMES]; /* outermost first */
+  int frame_count;
+  int truncated;
+  uint64_t hash;
+  uint64_t count;
+  uint64_t bytes;
+  struct zion_alloc_stack *next; /* in the same bucket */
+};
+
+static struct zion_alloc_stack *zion_alloc_stacks[ZION_ALLOC_PROFILE_BUCKETS];
+static size_t zion_alloc_stack_count;
+static int zion_alloc_profile_by_count;
+
+void zion_alloc_profile_enter(const char *call_site) {
+  if (zion_alloc_call_depth < ZION_ALLOC_PROFILE_MAX_DEPTH) {
+    zion_alloc_call_sites[zion_alloc_call_depth] = call_site;
+  }
+  ++zion_alloc_call_depth;
+}
+
+void zion_alloc_profile_leave() {
+  --zion_alloc_call_depth;
+}
+
+static int zion_alloc_stack_cmp(const void *a, const void *b) {
+  const struct zion_alloc_stack *lhs = *(const struct zion_alloc_stack **)a;
+  const struct zion_alloc_stack *rhs = *(const struct zion_alloc_stack **)b;
+  uint64_t lhs_weight = zion_alloc_profile_by_count ? lhs->count : lhs->bytes;
+  uint64_t rhs_weight = zion_alloc_profile_by_count ? rhs->count : rhs->bytes;
+  if (lhs_weight != rhs_weight) {
+    return lhs_weight < rhs_weight ? 1 : -1;
+  }
+  return strcmp(lhs->site, rhs->site);
+}
+
+static void zion_alloc_profile_dump() {
+  const char *mode = getenv("ZION_ALLOC_PROFILE");
+  zion_alloc_profile_by_count = mode != NULL && strcmp(mode, "count") == 0;
+
+  struct zion_alloc_stack **stacks = malloc(sizeof(stacks[0]) *
+                                            zion_alloc_stack_count);
+  if (stacks == NULL) {
+    return;
+  }
+  size_t i = 0;
+  for (size_t bucket = 0; bucket < ZION_ALLOC_PROFILE_BUCKETS; ++bucket) {
+    for (struct zion_alloc_stack *stack = zion_alloc_stacks[bucket];
+         stack != NULL; stack = stack->next) {
+      stacks[i++] = stack;
+    }
+  }
+  qsort(stacks, zion_alloc_stack_count, sizeof(stacks[0]),
+        zion_alloc_stack_cmp);
+
+  for (i = 0; i < zion_alloc_stack_count; ++i) {
+    struct zion_alloc_stack *stack = stacks[i];
+    if (stack->truncated) {
+      fputs("...;", stderr);
+    }
+    for (int frame = 0; frame < stack->frame_count; ++frame) {
+      fputs(stack->frames[frame], stderr);
+      fputc(';', stderr);
+    }
+    fprintf(stderr, "%s %" PRIu64 "\n", stack->site,
+            zion_alloc_profile_by_count ? stack->count : stack->bytes);
+  }
+  free(stacks);
+}
+
+void zion_alloc_profile(const char *site, uint64_t cb) {
+  int64_t depth = zion_alloc_call_depth < ZION_ALLOC_PROFILE_MAX_DEPTH
+                      ? zion_alloc_call_depth
+                      : ZION_ALLOC_PROFILE_MAX_DEPTH;
+  int frame_count = depth < ZION_ALLOC_PROFILE_FRAMES
+                        ? (int)depth
+                        : ZION_ALLOC_PROFILE_FRAMES;
+  const char **frames = zion_alloc_call_sites + depth - frame_count;
+  int truncated = zion_alloc_call_depth > frame_count;
+
+  /* names are compared by address. a name the compiler emitted twice only
+   * splits its stack over two lines, which folded stack tools add up */
+  uint64_t hash = 14695981039346656037ULL ^ (uint64_t)(uintptr_t)site;
+  for (int i = 0; i < frame_count; ++i) {
+    hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ULL;
+  }
+  hash ^= truncated;
+
+  struct zion_alloc_stack **bucket =
+      &zion_alloc_stacks[(hash ^ (hash >> 32)) % ZION_ALLOC_PROFILE_BUCKETS];
+  struct zion_alloc_stack *stack = *bucket;
+  for (; stack != NULL; stack = stack->next) {
+    if (stack->hash == hash && stack->site == site &&
+        stack->frame_count == frame_count && stack->truncated == truncated &&
+        memcmp(stack->frames, frames, sizeof(frames[0]) * frame_count) == 0) {
+      break;
+    }
+  }
+  if (stack == NULL) {
+    stack = calloc(1, sizeof(*stack));
+    if (stack == NULL) {
+      return;
+    }
+    if (zion_alloc_stack_count == 0) {
+      atexit(zion_alloc_profile_dump);
+    }
+    stack->site = site;
+    memcpy(stack->frames, frames, sizeof(frames[0]) * frame_count);
+    stack->frame_count = frame_count;
+    stack->truncated = truncated;
+    stack->hash = hash;
+    stack->next = *bucket;
+    *bucket = stack;
+    ++zion_alloc_stack_count;
+  }
+  stack->count += 1;
+  stack->bytes += cb;
+}
+
 int64_t zion_strlen(const char *sz) {
 	return strlen(sz);
 }
@@ -149,13 +1014,384 @@ double zion_itof(int64_t x) {
   return (double)x;
 }
 
-char *zion_itoa(int64_t x) {
-  char sz[128];
-  if (snprintf(sz, sizeof(sz), "%" PRId64, x) < 1) {
-    perror("Failed in zion_itoa");
-    exit(1);
+/* Number formatting. These write into caller-provided buffers, so callers
+ * that stream numbers (StringBuilder, the JSON writer) never copy or
+ * allocate. */
+
+static const char zion_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static int zion_decimal_length(uint64_t x) {
+  int length = 1;
+  while (x >= 10000) {
+    x /= 10000;
+    length += 4;
   }
-  return GC_strndup(sz, strlen(sz));
+  return length + (x >= 10) + (x >= 100) + (x >= 1000);
+}
+
+/* Writes the decimal digits of x, two at a time from the right, filling
+ * exactly length bytes of buf. */
+static void zion_write_digits(char *buf, uint64_t x, int length) {
+  char *p = buf + length;
+  while (x >= 100) {
+    uint64_t pair = (x % 100) * 2;
+    x /= 100;
+    p -= 2;
+    memcpy(p, zion_digit_pairs + pair, 2);
+  }
+  if (x >= 10) {
+    p -= 2;
+    memcpy(p, zion_digit_pairs + x * 2, 2);
+  } else {
+    *--p = '0' + (char)x;
+  }
+}
+
+/* Writes the decimal form of x to buf, which needs room for 20 bytes, and
+ * returns the number of bytes written. No terminator is written. */
+int64_t zion_format_int(char *buf, int64_t x) {
+  uint64_t magnitude = x < 0 ? -(uint64_t)x : (uint64_t)x;
+  int sign = x < 0;
+  if (sign) {
+    buf[0] = '-';
+  }
+  int length = zion_decimal_length(magnitude);
+  zion_write_digits(buf + sign, magnitude, length);
+  return sign + length;
+}
+
+/* The number of bytes zion_format_int writes for x. */
+int64_t zion_int_length(int64_t x) {
+  uint64_t magnitude = x < 0 ? -(uint64_t)x : (uint64_t)x;
+  return (x < 0) + zion_decimal_length(magnitude);
+}
+
+/* Big enough for any power of 5 or 10 the tables below need, and for
+ * 2^1800 divided down by them. */
+#define ZION_BIGNUM_LIMBS 60
+
+struct zion_bignum {
+  uint32_t limbs[ZION_BIGNUM_LIMBS]; /* least significant first */
+  int size;
+};
+
+static void zion_bignum_set_pow2(struct zion_bignum *x, int exponent) {
+  memset(x->limbs, 0, sizeof(x->limbs));
+  x->limbs[exponent / 32] = (uint32_t)1 << (exponent % 32);
+  x->size = exponent / 32 + 1;
+}
+
+static void zion_bignum_multiply(struct zion_bignum *x, uint32_t m) {
+  uint64_t carry = 0;
+  for (int i = 0; i < x->size; ++i) {
+    uint64_t product = (uint64_t)x->limbs[i] * m + carry;
+    x->limbs[i] = (uint32_t)product;
+    carry = product >> 32;
+  }
+  if (carry != 0) {
+    x->limbs[x->size++] = (uint32_t)carry;
+  }
+}
+
+static void zion_bignum_divide(struct zion_bignum *x, uint32_t d) {
+  uint64_t remainder = 0;
+  for (int i = x->size - 1; i >= 0; --i) {
+    uint64_t dividend = (remainder << 32) | x->limbs[i];
+    x->limbs[i] = (uint32_t)(dividend / d);
+    remainder = dividend % d;
+  }
+  while (x->size > 1 && x->limbs[x->size - 1] == 0) {
+    --x->size;
+  }
+}
+
+static int zion_bignum_bit_length(const struct zion_bignum *x) {
+  uint32_t top = x->limbs[x->size - 1];
+  return (x->size - 1) * 32 + (top == 0 ? 0 : 32 - __builtin_clz(top));
+}
+
+/* Returns floor(x / 2^shift) when that fits in 128 bits. A negative shift
+ * multiplies instead. */
+static unsigned __int128 zion_bignum_bits(const struct zion_bignum *x,
+                                          int shift) {
+  if (shift < 0) {
+    return zion_bignum_bits(x, 0) << -shift;
+  }
+  unsigned __int128 bits = 0;
+  for (int i = 0; i < 4; ++i) {
+    int bit = shift + i * 32;
+    int limb = bit / 32;
+    int offset = bit % 32;
+    uint64_t word = 0;
+    if (limb < x->size) {
+      word = x->limbs[limb] >> offset;
+    }
+    if (offset != 0 && limb + 1 < x->size) {
+      word |= (uint64_t)x->limbs[limb + 1] << (32 - offset);
+    }
+    bits |= (unsigned __int128)(uint32_t)word << (i * 32);
+  }
+  return bits;
+}
+
+/* floor(e * log10(2)), floor(e * log10(2) - log10(4/3)) and floor(e *
+ * log2(10)) for the exponents these algorithms see. */
+#define zion_flog10pow2(e) ((int)(((int64_t)(e)*661971961083LL) >> 41))
+#define zion_flog10_three_quarters_pow2(e) \
+  ((int)(((int64_t)(e)*661971961083LL - 274743187321LL) >> 41))
+#define zion_flog2pow10(e) ((int)(((int64_t)(e)*913124641741LL) >> 38))
+
+/* Schubfach's table: for k in [-324, 292], g = floor(10^-k * 2^(125 -
+ * flog2pow10(-k))) + 1, an over-approximation of 10^-k that lies in [2^125,
+ * 2^126). */
+#define ZION_SCHUBFACH_K_MIN -324
+#define ZION_SCHUBFACH_K_MAX 292
+static unsigned __int128 zion_schubfach_g[ZION_SCHUBFACH_K_MAX -
+                                          ZION_SCHUBFACH_K_MIN + 1];
+
+/* Eisel-Lemire's table: for q in [-342, 308], 5^q normalized to 128 bits
+ * (rounded up for negative q, as in the fast_float library.) */
+#define ZION_POW5_Q_MIN -342
+#define ZION_POW5_Q_MAX 308
+static unsigned __int128 zion_pow5_128[ZION_POW5_Q_MAX - ZION_POW5_Q_MIN + 1];
+
+static int zion_number_tables_ready;
+
+/* The tables come from exact big integer arithmetic at the first call that
+ * needs them, which is cheaper than it sounds (well under a millisecond) and
+ * keeps a few hundred lines of constants out of the runtime. */
+static void zion_init_number_tables() {
+  struct zion_bignum x;
+
+  /* positive powers: 10^e and 5^q */
+  zion_bignum_set_pow2(&x, 0);
+  for (int e = 0; e <= -ZION_SCHUBFACH_K_MIN; ++e) {
+    int r = zion_flog2pow10(e);
+    zion_schubfach_g[-e - ZION_SCHUBFACH_K_MIN] = zion_bignum_bits(&x,
+                                                                   r - 125) +
+                                                  1;
+    zion_bignum_multiply(&x, 10);
+  }
+  zion_bignum_set_pow2(&x, 0);
+  for (int q = 0; q <= ZION_POW5_Q_MAX; ++q) {
+    zion_pow5_128[q - ZION_POW5_Q_MIN] = zion_bignum_bits(
+        &x, zion_bignum_bit_length(&x) - 128);
+    zion_bignum_multiply(&x, 5);
+  }
+
+  /* negative powers, from 2^1800 divided down one step at a time; floor
+   * division composes, so each step is exact */
+  const int top = 1800;
+  zion_bignum_set_pow2(&x, top);
+  for (int e = 1; e <= ZION_SCHUBFACH_K_MAX; ++e) {
+    zion_bignum_divide(&x, 10);
+    int r = zion_flog2pow10(-e);
+    zion_schubfach_g[e - ZION_SCHUBFACH_K_MIN] = zion_bignum_bits(
+                                                     &x, top - (125 - r)) +
+                                                 1;
+  }
+  struct zion_bignum power = x;
+  zion_bignum_set_pow2(&x, top);
+  zion_bignum_set_pow2(&power, 0);
+  for (int n = 1; n <= -ZION_POW5_Q_MIN; ++n) {
+    zion_bignum_divide(&x, 5);
+    zion_bignum_multiply(&power, 5);
+    /* fast_float takes c = floor(2^b / 5^n) + 1 and halves it until it fits
+     * in 128 bits, where 2^z is the first power of two above 5^n */
+    int z = zion_bignum_bit_length(&power);
+    int b = n <= 27 ? z + 127 : 2 * z + 128;
+    int shift = top - b;
+    int excess = n <= 27 ? 0 : z + 1;
+    /* adding one before halving only carries when every bit halved away is
+     * a one */
+    int carry = 1;
+    for (int bit = shift; bit < shift + excess; ++bit) {
+      if (((x.limbs[bit / 32] >> (bit % 32)) & 1) == 0) {
+        carry = 0;
+        break;
+      }
+    }
+    zion_pow5_128[-n - ZION_POW5_Q_MIN] = zion_bignum_bits(&x, shift + excess) +
+                                          carry;
+  }
+  zion_number_tables_ready = 1;
+}
+
+static void zion_require_number_tables() {
+  if (!zion_number_tables_ready) {
+    zion_init_number_tables();
+  }
+}
+
+/* Raffaello Giulietti's Schubfach: finds the shortest decimal that rounds
+ * back to the double (the closest one when there is a choice), with a couple
+ * of 128 bit multiplications and no loops over digits. */
+static uint64_t zion_round_odd(unsigned __int128 g, uint64_t cp) {
+  /* floor(g * cp / 2^128), with the lowest bit set if anything was lost */
+  uint64_t g1 = (uint64_t)(g >> 64);
+  uint64_t g0 = (uint64_t)g;
+  unsigned __int128 x = (unsigned __int128)g0 * cp;
+  unsigned __int128 y = (unsigned __int128)g1 * cp + (uint64_t)(x >> 64);
+  uint64_t y1 = (uint64_t)(y >> 64);
+  uint64_t y0 = (uint64_t)y;
+  return y1 | (y0 > 1);
+}
+
+static void zion_schubfach(int q, uint64_t c, uint64_t *digits,
+                           int *exponent) {
+  uint64_t out = c & 1;
+  uint64_t cb = c << 2;
+  uint64_t cbr = cb + 2;
+  uint64_t cbl;
+  int k;
+  if (c != ((uint64_t)1 << 52) || q == -1074) {
+    cbl = cb - 2;
+    k = zion_flog10pow2(q);
+  } else {
+    /* at a power of two the gap below is half as wide as the one above */
+    cbl = cb - 1;
+    k = zion_flog10_three_quarters_pow2(q);
+  }
+  int h = q + zion_flog2pow10(-k) + 3;
+  unsigned __int128 g = zion_schubfach_g[k - ZION_SCHUBFACH_K_MIN];
+  uint64_t vb = zion_round_odd(g, cb << h);
+  uint64_t vbl = zion_round_odd(g, cbl << h);
+  uint64_t vbr = zion_round_odd(g, cbr << h);
+
+  uint64_t s = vb >> 2;
+  if (s >= 10) {
+    /* try one digit fewer first */
+    uint64_t sp10 = s / 10 * 10;
+    uint64_t tp10 = sp10 + 10;
+    int upin = vbl + out <= sp10 << 2;
+    int wpin = (tp10 << 2) + out <= vbr;
+    if (upin != wpin) {
+      *digits = upin ? sp10 : tp10;
+      *exponent = k;
+      return;
+    }
+  }
+  uint64_t t = s + 1;
+  int uin = vbl + out <= s << 2;
+  int win = (t << 2) + out <= vbr;
+  if (uin != win) {
+    *digits = uin ? s : t;
+    *exponent = k;
+    return;
+  }
+  int64_t cmp = (int64_t)(vb - ((s + t) << 1));
+  *digits = cmp < 0 || (cmp == 0 && (s & 1) == 0) ? s : t;
+  *exponent = k;
+}
+
+/* Writes the shortest decimal that reads back as x, in the style of Python's
+ * repr: 0.1, 100.0, 1e+16, 5e-324, -0.0, inf and nan. buf needs room for 25
+ * bytes. Returns the number of bytes written; no terminator is written. */
+int64_t zion_format_float_shortest(char *buf, double x) {
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  char *p = buf;
+  if (bits >> 63) {
+    *p++ = '-';
+  }
+  uint64_t t = bits & (((uint64_t)1 << 52) - 1);
+  int bq = (int)(bits >> 52) & 0x7ff;
+
+  uint64_t digits;
+  int exponent;
+  if (bq == 0x7ff) {
+    if (t != 0) {
+      memcpy(buf, "nan", 3);
+      return 3;
+    }
+    memcpy(p, "inf", 3);
+    return p + 3 - buf;
+  } else if (bq == 0 && t == 0) {
+    memcpy(p, "0.0", 3);
+    return p + 3 - buf;
+  } else if (bq != 0) {
+    int mq = 1075 - bq;
+    uint64_t c = ((uint64_t)1 << 52) | t;
+    if (0 < mq && mq < 53 && ((c >> mq) << mq) == c) {
+      /* small integers need no search */
+      digits = c >> mq;
+      exponent = 0;
+    } else {
+      zion_require_number_tables();
+      zion_schubfach(-mq, c, &digits, &exponent);
+    }
+  } else {
+    /* subnormal */
+    zion_require_number_tables();
+    zion_schubfach(-1074, t, &digits, &exponent);
+  }
+
+  while (digits % 10 == 0) {
+    digits /= 10;
+    ++exponent;
+  }
+  int length = zion_decimal_length(digits);
+  /* the value is 0.DIGITS * 10^point */
+  int point = length + exponent;
+  if (point > -4 && point <= 16) {
+    if (point <= 0) {
+      memcpy(p, "0.", 2);
+      memset(p + 2, '0', -point);
+      p += 2 - point;
+      zion_write_digits(p, digits, length);
+      p += length;
+    } else if (point < length) {
+      zion_write_digits(p + 1, digits, length);
+      memmove(p, p + 1, point);
+      p[point] = '.';
+      p += length + 1;
+    } else {
+      zion_write_digits(p, digits, length);
+      memset(p + length, '0', point - length);
+      p += point;
+      memcpy(p, ".0", 2);
+      p += 2;
+    }
+  } else {
+    zion_write_digits(p + 1, digits, length);
+    p[0] = p[1];
+    if (length > 1) {
+      p[1] = '.';
+      p += length + 1;
+    } else {
+      p += 1;
+    }
+    int e = point - 1;
+    *p++ = 'e';
+    *p++ = e < 0 ? '-' : '+';
+    if (e < 0) {
+      e = -e;
+    }
+    if (e < 10) {
+      *p++ = '0';
+    }
+    int e_length = zion_decimal_length(e);
+    zion_write_digits(p, e, e_length);
+    p += e_length;
+  }
+  return p - buf;
+}
+
+char *zion_itoa(int64_t x) {
+  char sz[21];
+  int64_t length = zion_format_int(sz, x);
+  sz[length] = '\0';
+  return GC_strndup(sz, length);
 }
 
 const char *zion_dup_free(const char *src) {
@@ -175,22 +1411,323 @@ char *zion_ftoa(double x) {
   return GC_strndup(sz, strlen(sz));
 }
 
+/* Writes x to buf the way zion_ftoa does, terminator included. Like snprintf,
+ * returns the length the result needs, which is size or more when buf was too
+ * small for it. */
+int64_t zion_format_float(char *buf, int64_t size, double x) {
+  int length = snprintf(buf, size, "%.6f", x);
+  if (length < 1) {
+    perror("Failed in zion_format_float");
+    exit(1);
+  }
+  return length;
+}
+
+/* Like zion_ftoa, but with the fewest digits that read back as x. */
+char *zion_ftoa_shortest(double x) {
+  char sz[32];
+  int64_t length = zion_format_float_shortest(sz, x);
+  return GC_strndup(sz, length);
+}
+
+/* Parsing reports problems the way system calls do: the value comes back
+ * directly and zion_number_parse_status says whether it is any good. */
+enum {
+  zion_parse_ok,
+  zion_parse_invalid,
+  zion_parse_out_of_range,
+};
+
+static int64_t zion_parse_status;
+
+int64_t zion_number_parse_status() {
+  return zion_parse_status;
+}
+
+/* Reads an optional sign and then decimal digits from [s, end), stopping at
+ * the first byte that does not fit. Returns where it stopped, which is s when
+ * there were no digits. Out of range values saturate. */
+static const char *zion_scan_int(const char *s,
+                                 const char *end,
+                                 int64_t *value,
+                                 int *status) {
+  const char *p = s;
+  int negative = 0;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  const char *digits = p;
+  uint64_t magnitude = 0;
+  uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+  *status = zion_parse_ok;
+  for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+    uint64_t digit = *p - '0';
+    if (magnitude > (limit - digit) / 10) {
+      *status = zion_parse_out_of_range;
+      magnitude = limit;
+    } else if (*status == zion_parse_ok) {
+      magnitude = magnitude * 10 + digit;
+    }
+  }
+  if (p == digits) {
+    *status = zion_parse_invalid;
+    *value = 0;
+    return s;
+  }
+  *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+  return p;
+}
+
+/* Daniel Lemire's take on Michel Hack's and Eisel's idea: w * 10^q is close
+ * enough to w * the 128 bit approximation of 5^q (times a power of two) that
+ * the correctly rounded double can almost always be read off the product.
+ * Returns 0 when it cannot (which, for a w of up to 19 digits, the fast_float
+ * authors have shown never happens) and the caller should fall back. */
+static int zion_eisel_lemire(int64_t q, uint64_t w, int negative,
+                             double *value) {
+  uint64_t bits;
+  if (w == 0 || q < ZION_POW5_Q_MIN) {
+    bits = 0;
+  } else if (q > ZION_POW5_Q_MAX) {
+    bits = (uint64_t)0x7ff << 52;
+  } else {
+    zion_require_number_tables();
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    unsigned __int128 power = zion_pow5_128[q - ZION_POW5_Q_MIN];
+    unsigned __int128 product = (unsigned __int128)w * (uint64_t)(power >> 64);
+    uint64_t high = (uint64_t)(product >> 64);
+    uint64_t low = (uint64_t)product;
+    if ((high & 0x1ff) == 0x1ff) {
+      /* the bits we keep could still change; bring in the rest of 5^q */
+      unsigned __int128 second = (unsigned __int128)w * (uint64_t)power;
+      uint64_t carry_in = (uint64_t)(second >> 64);
+      low += carry_in;
+      if (low < carry_in) {
+        ++high;
+      }
+      if ((high & 0x1ff) == 0x1ff && low + w < low) {
+        return 0;
+      }
+    }
+    int upper_bit = (int)(high >> 63);
+    int shift = upper_bit + 64 - 52 - 3;
+    uint64_t mantissa = high >> shift;
+    int power2 = (int)((((152170 + 65536) * q) >> 16) + 63) + upper_bit - lz +
+                 1023;
+    if (power2 <= 0) {
+      /* subnormal */
+      if (-power2 + 1 >= 64) {
+        bits = 0;
+      } else {
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < ((uint64_t)1 << 52) ? 0 : 1;
+        bits = ((uint64_t)power2 << 52) | (mantissa & (((uint64_t)1 << 52) - 1));
+      }
+    } else {
+      /* exactly halfway between two doubles rounds to the even one */
+      if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+          (mantissa << shift) == high) {
+        mantissa &= ~(uint64_t)1;
+      }
+      mantissa += mantissa & 1;
+      mantissa >>= 1;
+      if (mantissa >= ((uint64_t)2 << 52)) {
+        mantissa = (uint64_t)1 << 52;
+        ++power2;
+      }
+      mantissa &= ~((uint64_t)1 << 52);
+      if (power2 >= 0x7ff) {
+        power2 = 0x7ff;
+        mantissa = 0;
+      }
+      bits = ((uint64_t)power2 << 52) | mantissa;
+    }
+  }
+  bits |= (uint64_t)negative << 63;
+  memcpy(value, &bits, sizeof(bits));
+  return 1;
+}
+
+static int zion_match_word(const char *p, const char *end, const char *word) {
+  size_t length = strlen(word);
+  if ((size_t)(end - p) < length) {
+    return 0;
+  }
+  for (size_t i = 0; i < length; ++i) {
+    if (zion_fold_ascii(p[i]) != word[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Reads a decimal floating point number (or inf, infinity or nan, in any
+ * case) from [s, end), stopping at the first byte that does not fit, and
+ * returns where it stopped, which is s when there was no number. */
+static const char *zion_scan_float(const char *s,
+                                   const char *end,
+                                   double *value,
+                                   int *status) {
+  const char *p = s;
+  int negative = 0;
+  *status = zion_parse_ok;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  if (p < end && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N')) {
+    if (zion_match_word(p, end, "infinity")) {
+      *value = negative ? -HUGE_VAL : HUGE_VAL;
+      return p + 8;
+    } else if (zion_match_word(p, end, "inf")) {
+      *value = negative ? -HUGE_VAL : HUGE_VAL;
+      return p + 3;
+    } else if (zion_match_word(p, end, "nan")) {
+      *value = negative ? -NAN : NAN;
+      return p + 3;
+    }
+    *status = zion_parse_invalid;
+    *value = 0;
+    return s;
+  }
+
+  /* w collects the first 19 significant digits; the rest only move the
+   * decimal point, and truncated notes whether any of them was nonzero */
+  uint64_t w = 0;
+  int significant = 0;
+  int truncated = 0;
+  int64_t exponent = 0;
+  int any_digits = 0;
+  for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+    any_digits = 1;
+    if (significant < 19) {
+      w = w * 10 + (*p - '0');
+      significant += w != 0;
+    } else {
+      ++exponent;
+      truncated |= *p != '0';
+    }
+  }
+  if (p < end && *p == '.') {
+    const char *fraction = ++p;
+    for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+      if (significant < 19) {
+        w = w * 10 + (*p - '0');
+        significant += w != 0;
+        --exponent;
+      } else {
+        truncated |= *p != '0';
+      }
+    }
+    any_digits |= p != fraction;
+  }
+  if (!any_digits) {
+    *status = zion_parse_invalid;
+    *value = 0;
+    return s;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *e = p + 1;
+    int e_negative = 0;
+    if (e < end && (*e == '-' || *e == '+')) {
+      e_negative = *e == '-';
+      ++e;
+    }
+    if (e < end && (unsigned)(*e - '0') < 10) {
+      int64_t e_value = 0;
+      for (; e < end && (unsigned)(*e - '0') < 10; ++e) {
+        /* anything this large is already 0 or infinity */
+        if (e_value < 100000) {
+          e_value = e_value * 10 + (*e - '0');
+        }
+      }
+      exponent += e_negative ? -e_value : e_value;
+      p = e;
+    }
+  }
+
+  /* Clinger's fast path: both w and 10^|exponent| are exact doubles, so
+   * one correctly rounded operation gives the answer */
+  static const double powers_of_ten[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  if (!truncated && w <= ((uint64_t)1 << 53) && exponent >= -22 &&
+      exponent <= 22) {
+    double d = (double)w;
+    d = exponent < 0 ? d / powers_of_ten[-exponent] : d * powers_of_ten[exponent];
+    *value = negative ? -d : d;
+  } else {
+    double lower, upper;
+    int ok = zion_eisel_lemire(exponent, w, negative, &lower);
+    if (ok && truncated) {
+      /* the digits we dropped put the value between w and w + 1 */
+      ok = zion_eisel_lemire(exponent, w + 1, negative, &upper) &&
+           lower == upper;
+    }
+    if (!ok) {
+      /* rare enough that copying for strtod does not matter */
+      size_t length = p - s;
+      char *copy = malloc(length + 1);
+      memcpy(copy, s, length);
+      copy[length] = '\0';
+      lower = strtod(copy, NULL);
+      free(copy);
+    }
+    *value = lower;
+  }
+  if (isinf(*value)) {
+    *status = zion_parse_out_of_range;
+  }
+  return p;
+}
+
+/* Parses all of [s, s + length) as an integer, setting
+ * zion_number_parse_status. */
+int64_t zion_parse_int(const char *s, int64_t length) {
+  int64_t value;
+  int status;
+  const char *end = zion_scan_int(s, s + length, &value, &status);
+  if (status == zion_parse_ok && end != s + length) {
+    status = zion_parse_invalid;
+  }
+  zion_parse_status = status;
+  return value;
+}
+
+/* Parses all of [s, s + length) as a float, setting
+ * zion_number_parse_status. */
+double zion_parse_float(const char *s, int64_t length) {
+  double value;
+  int status;
+  const char *end = zion_scan_float(s, s + length, &value, &status);
+  if (status == zion_parse_ok && end != s + length) {
+    status = zion_parse_invalid;
+  }
+  zion_parse_status = status;
+  return value;
+}
+
+/* atof and atoll without the copy: leading space is skipped, whatever
+ * follows the number is ignored, and 0 means there was no number. */
 double zion_atof(const char *sz, size_t n) {
-  char buf[64];
-  const size_t buf_size = sizeof(buf) / sizeof(buf[0]);
-  size_t byte_count_to_copy = (n >= buf_size ? buf_size - 1 : n);
-  memcpy(buf, sz, byte_count_to_copy);
-  buf[byte_count_to_copy] = '\0';
-  return atof(buf);
+  int64_t skipped = zion_skip_space(sz, n);
+  double value;
+  int status;
+  zion_scan_float(sz + skipped, sz + n, &value, &status);
+  return value;
 }
 
 int64_t zion_atoi(const char *sz, size_t n) {
-	char buf[64];
-	const size_t buf_size = sizeof(buf) / sizeof(buf[0]);
-	size_t byte_count_to_copy = (n >= buf_size ? buf_size - 1 : n);
-	memcpy(buf, sz, byte_count_to_copy);
-	buf[byte_count_to_copy] = '\0';
-	return atoll(buf);
+  int64_t skipped = zion_skip_space(sz, n);
+  int64_t value;
+  int status;
+  zion_scan_int(sz + skipped, sz + n, &value, &status);
+  return value;
 }
 
 void zion_pass_test() {
@@ -223,6 +1760,229 @@ int64_t zion_epoch_millis() {
   return (int64_t)s * 1000 + ms;
 }
 
-int64_t zion_hash_combine(uint64_t seed, uint64_t value) {
-  return seed ^ (value + 0x9e3779b97f4a7c15LLU + (seed << 12) + (seed >> 4));
+/* byte hashing for Hashable. the default is wyhash (final version 4), which is
+ * fast and well distributed but not keyed. programs that hash untrusted input
+ * can switch to SipHash-1-3 under a random key, either by calling
+ * hash.use_keyed_hashing() or by running with ZION_HASH=siphash. */
+static int zion_hash_keyed = 0;
+static uint64_t zion_hash_key[2];
+
+static const uint64_t zion_wyp[4] = {
+    0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL,
+    0x589965cc75374cc3ULL};
+
+static inline uint64_t zion_read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t zion_read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t zion_wymix(uint64_t a, uint64_t b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static uint64_t zion_wyhash(const uint8_t *p, size_t len, uint64_t seed) {
+  uint64_t a, b;
+  seed ^= zion_wymix(seed ^ zion_wyp[0], zion_wyp[1]);
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (zion_read32(p) << 32) | zion_read32(p + ((len >> 3) << 2));
+      b = (zion_read32(p + len - 4) << 32) |
+          zion_read32(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      /* three independent lanes keep the multipliers busy on long keys */
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = zion_wymix(zion_read64(p) ^ zion_wyp[1],
+                          zion_read64(p + 8) ^ seed);
+        see1 = zion_wymix(zion_read64(p + 16) ^ zion_wyp[2],
+                          zion_read64(p + 24) ^ see1);
+        see2 = zion_wymix(zion_read64(p + 32) ^ zion_wyp[3],
+                          zion_read64(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = zion_wymix(zion_read64(p) ^ zion_wyp[1],
+                        zion_read64(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = zion_read64(p + i - 16);
+    b = zion_read64(p + i - 8);
+  }
+  __uint128_t r = (__uint128_t)(a ^ zion_wyp[1]) * (b ^ seed);
+  return zion_wymix((uint64_t)r ^ zion_wyp[0] ^ len,
+                    (uint64_t)(r >> 64) ^ zion_wyp[1]);
+}
+
+#define ZION_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define ZION_SIPROUND                                                          \
+  do {                                                                         \
+    v0 += v1;                                                                  \
+    v1 = ZION_ROTL(v1, 13);                                                    \
+    v1 ^= v0;                                                                  \
+    v0 = ZION_ROTL(v0, 32);                                                    \
+    v2 += v3;                                                                  \
+    v3 = ZION_ROTL(v3, 16);                                                    \
+    v3 ^= v2;                                                                  \
+    v0 += v3;                                                                  \
+    v3 = ZION_ROTL(v3, 21);                                                    \
+    v3 ^= v0;                                                                  \
+    v2 += v1;                                                                  \
+    v1 = ZION_ROTL(v1, 17);                                                    \
+    v1 ^= v2;                                                                  \
+    v2 = ZION_ROTL(v2, 32);                                                    \
+  } while (0)
+
+static uint64_t zion_siphash13(const uint8_t *p,
+                               size_t len,
+                               uint64_t k0,
+                               uint64_t k1) {
+  uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+  uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+  uint64_t v3 = 0x7465646279746573ULL ^ k1;
+  const uint8_t *end = p + (len & ~(size_t)7);
+  for (; p != end; p += 8) {
+    uint64_t m = zion_read64(p);
+    v3 ^= m;
+    ZION_SIPROUND;
+    v0 ^= m;
+  }
+
+  uint64_t m = (uint64_t)len << 56;
+  switch (len & 7) {
+  case 7:
+    m |= (uint64_t)p[6] << 48;
+    /* fall through */
+  case 6:
+    m |= (uint64_t)p[5] << 40;
+    /* fall through */
+  case 5:
+    m |= (uint64_t)p[4] << 32;
+    /* fall through */
+  case 4:
+    m |= (uint64_t)p[3] << 24;
+    /* fall through */
+  case 3:
+    m |= (uint64_t)p[2] << 16;
+    /* fall through */
+  case 2:
+    m |= (uint64_t)p[1] << 8;
+    /* fall through */
+  case 1:
+    m |= (uint64_t)p[0];
+  }
+  v3 ^= m;
+  ZION_SIPROUND;
+  v0 ^= m;
+
+  v2 ^= 0xff;
+  ZION_SIPROUND;
+  ZION_SIPROUND;
+  ZION_SIPROUND;
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+int64_t zion_hash_bytes(const uint8_t *p, int64_t len) {
+  uint64_t hash = zion_hash_keyed ? zion_siphash13(p, len, zion_hash_key[0],
+                                                   zion_hash_key[1])
+                                  : zion_wyhash(p, len, 0);
+  return (int64_t)(hash & INT64_MAX);
+}
+
+int64_t zion_hash_float(double x) {
+  /* 0.0 and -0.0 compare equal, so they must hash the same */
+  if (x == 0.0) {
+    x = 0.0;
+  }
+  return zion_hash_bytes((const uint8_t *)&x, sizeof(x));
+}
+
+void *zion_hash_use_keyed() {
+  if (!zion_hash_keyed) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd == -1 ||
+        read(fd, zion_hash_key, sizeof(zion_hash_key)) !=
+            sizeof(zion_hash_key)) {
+      fprintf(stderr, "zion: unable to read a hash key from /dev/urandom\n");
+      exit(1);
+    }
+    close(fd);
+    zion_hash_keyed = 1;
+  }
+  return 0;
+}
+
+int64_t zion_gc_heap_size() {
+  return (int64_t)GC_get_heap_size();
+}
+
+int64_t zion_gc_total_bytes() {
+  return (int64_t)GC_get_total_bytes();
+}
+
+int64_t zion_gc_count() {
+  return (int64_t)GC_get_gc_no();
+}
+
+int64_t zion_gc_total_pause_micros() {
+  return zion_gc_total_pause;
+}
+
+int64_t zion_gc_last_pause_micros() {
+  return zion_gc_last_pause;
+}
+
+int64_t zion_gc_max_pause_micros() {
+  return zion_gc_max_pause;
+}
+
+int64_t zion_gc_pause_count() {
+  return zion_gc_pauses;
+}
+
+int64_t zion_gc_total_cycle_micros() {
+  return zion_gc_total_cycle;
+}
+
+int64_t zion_gc_last_cycle_micros() {
+  return zion_gc_last_cycle;
+}
+
+void *zion_gc_collect() {
+  GC_gcollect();
+  return 0;
+}
+
+void *zion_gc_disable() {
+  GC_disable();
+  return 0;
+}
+
+void *zion_gc_enable() {
+  GC_enable();
+  return 0;
+}
+
+int64_t zion_gc_expand_heap(int64_t cb) {
+  return GC_expand_hp(cb);
 }
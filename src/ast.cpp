@@ -188,7 +188,46 @@ Location Lambda::get_location() const {
   return vars[0].location;
 }
 
+bool is_function_attribute(const std::string &text) {
+  return text == "inline" || text == "noinline" || text == "cold" ||
+         text == "hot";
+}
+
+FunctionAttribute get_function_attribute(Location location,
+                                         const std::string &text) {
+  if (text == "inline") {
+    return fa_inline;
+  } else if (text == "noinline") {
+    return fa_noinline;
+  } else if (text == "cold") {
+    return fa_cold;
+  } else if (text == "hot") {
+    return fa_hot;
+  }
+  throw user_error(location, "unknown function attribute %s", text.c_str());
+}
+
+std::string function_attributes_str(int attributes) {
+  std::vector<std::string> names;
+  if (attributes & fa_inline) {
+    names.push_back("inline");
+  }
+  if (attributes & fa_noinline) {
+    names.push_back("noinline");
+  }
+  if (attributes & fa_cold) {
+    names.push_back("cold");
+  }
+  if (attributes & fa_hot) {
+    names.push_back("hot");
+  }
+  return join(names, " ");
+}
+
 std::ostream &Lambda::render(std::ostream &os, int parent_precedence) const {
+  if (attributes != 0) {
+    os << function_attributes_str(attributes) << " ";
+  }
   os << "(λ"
      << join_with(vars, ",", [](const Identifier &id) { return id.name; });
   os << " . ";
@@ -280,13 +280,29 @@ struct Application : public Expr {
   std::vector<const Expr *> params;
 };
 
+/* optimization hints that can prefix a function declaration. they are
+ * carried along with the Lambda through specialization and become LLVM
+ * function attributes in gen_lambda. */
+enum FunctionAttribute {
+  fa_inline = 1 << 0,
+  fa_noinline = 1 << 1,
+  fa_cold = 1 << 2,
+  fa_hot = 1 << 3,
+};
+
+bool is_function_attribute(const std::string &text);
+FunctionAttribute get_function_attribute(Location location,
+                                         const std::string &text);
+std::string function_attributes_str(int attributes);
+
 struct Lambda : public Expr {
   Lambda(Identifiers vars,
          types::Refs param_types,
          types::Ref return_type,
-         const Expr *body)
+         const Expr *body,
+         int attributes = 0)
       : vars(vars), body(body), param_types(param_types),
-        return_type(return_type) {
+        return_type(return_type), attributes(attributes) {
     assert(vars.size() != 0);
   }
   Location get_location() const override;
@@ -296,6 +312,8 @@ struct Lambda : public Expr {
   const Expr *body;
   types::Refs param_types;
   types::Ref return_type;
+  /* a bitmask of FunctionAttribute */
+  int attributes;
 };
 
 struct Let : public Expr {
@@ -106,6 +106,8 @@ const types::Scheme::Map &get_builtins() {
                                              type_arrows({tv_a, Int, Bool}));
     (*map)["__builtin_int_to_char"] = scheme(INTERNAL_LOC(), {}, {},
                                              type_arrows({Int, Char}));
+    (*map)["__builtin_char_to_int"] = scheme(INTERNAL_LOC(), {}, {},
+                                             type_arrows({Char, Int}));
     (*map)["__builtin_int_eq"] = scheme(INTERNAL_LOC(), {}, {},
                                         type_arrows({Int, Int, Bool}));
     (*map)["__builtin_int_ne"] = scheme(INTERNAL_LOC(), {}, {},
@@ -126,6 +128,12 @@ const types::Scheme::Map &get_builtins() {
                                                  type_arrows({Int, Int, Int}));
     (*map)["__builtin_int_bitwise_complement"] = scheme(
         INTERNAL_LOC(), {}, {}, type_arrows({Int, Int}));
+    (*map)["__builtin_int_shift_left"] = scheme(INTERNAL_LOC(), {}, {},
+                                                type_arrows({Int, Int, Int}));
+    (*map)["__builtin_int_shift_right_logical"] = scheme(
+        INTERNAL_LOC(), {}, {}, type_arrows({Int, Int, Int}));
+    (*map)["__builtin_int_count_trailing_zeros"] = scheme(
+        INTERNAL_LOC(), {}, {}, type_arrows({Int, Int}));
     (*map)["__builtin_char_eq"] = scheme(INTERNAL_LOC(), {}, {},
                                          type_arrows({Char, Char, Bool}));
     (*map)["__builtin_char_ne"] = scheme(INTERNAL_LOC(), {}, {},
@@ -160,6 +168,12 @@ const types::Scheme::Map &get_builtins() {
         INTERNAL_LOC(), {}, {}, type_arrows({Int, type_unit(INTERNAL_LOC())}));
     (*map)["__builtin_calloc"] = scheme(INTERNAL_LOC(), {"a"}, {},
                                         type_arrows({Int, tp_a}));
+    /* takes a tuple of literals with matching types, and returns a pointer to
+     * read-only static data holding them as an array. nothing here ties b to
+     * the literals, so callers must say what b is (the parser casts to *Int,
+     * *Float or *Char.) */
+    (*map)["__builtin_static_array"] = scheme(INTERNAL_LOC(), {"a", "b"}, {},
+                                              type_arrows({tv_a, tp_b}));
     (*map)["__builtin_store_ref"] =
         scheme(INTERNAL_LOC(), {"a"}, {},
                type_arrows(
@@ -20,6 +20,15 @@ namespace gen {
 
 typedef std::vector<llvm::Value *> DeferClosures;
 
+/* a function whose self-recursive tail calls are lowered into jumps back to
+ * loop_block. the function's params are bound to the phi nodes in loop_block
+ * rather than directly to its arguments. */
+struct TailRecursion {
+  llvm::Function *llvm_function;
+  llvm::BasicBlock *loop_block;
+  std::vector<llvm::PHINode *> llvm_params;
+};
+
 enum DeferType {
   dt_function = 0,
   dt_block = 1,
@@ -77,11 +86,33 @@ struct DeferGuard {
     defer_closures.push_back(llvm_closure);
   }
 
+  /* would call_deferred(builder, dt) emit any calls? */
+  bool has_deferred(DeferType dt) const {
+    if (defer_closures.size() != 0) {
+      return true;
+    }
+    if (defer_type != dt && defer_type != dt_function) {
+      assert(parent != nullptr);
+      return parent->has_deferred(dt);
+    }
+    return false;
+  }
+
+  TailRecursion *get_tail_recursion() const {
+    if (defer_type == dt_function) {
+      return tail_recursion;
+    }
+    assert(parent != nullptr);
+    return parent->get_tail_recursion();
+  }
+
   Location location;
   DeferGuard *parent;
   DeferType const defer_type;
   DeferClosures defer_closures;
   bool called = false;
+  /* only ever set on dt_function guards */
+  TailRecursion *tail_recursion = nullptr;
 };
 
 struct LoopGuard {
@@ -512,6 +543,9 @@ llvm::Value *gen_builtin(llvm::IRBuilder<> &builder,
   } else if (name == "__builtin_int_to_char") {
     /* scheme({}, {}, type_arrows({Int, Char})) */
     return builder.CreateSExtOrTrunc(params[0], builder.getInt8Ty());
+  } else if (name == "__builtin_char_to_int") {
+    /* scheme({}, {}, type_arrows({Char, Int})) */
+    return builder.CreateSExt(params[0], builder.getInt64Ty());
   } else if (name == "__builtin_int_eq") {
     /* scheme({}, {}, type_arrows({Int, Int, Bool})) */
     return builder.CreateZExt(builder.CreateICmpEQ(params[0], params[1]),
@@ -548,6 +582,19 @@ llvm::Value *gen_builtin(llvm::IRBuilder<> &builder,
   } else if (name == "__builtin_int_bitwise_complement") {
     /* scheme({}, {}, type_arrows({Int, Int})) */
     return builder.CreateXor(params[0], builder.getInt64(-1));
+  } else if (name == "__builtin_int_shift_left") {
+    /* scheme({}, {}, type_arrows({Int, Int, Int})) */
+    return builder.CreateShl(params[0], params[1]);
+  } else if (name == "__builtin_int_shift_right_logical") {
+    /* scheme({}, {}, type_arrows({Int, Int, Int})) */
+    return builder.CreateLShr(params[0], params[1]);
+  } else if (name == "__builtin_int_count_trailing_zeros") {
+    /* scheme({}, {}, type_arrows({Int, Int})) */
+    llvm::Function *llvm_cttz = llvm::Intrinsic::getDeclaration(
+        llvm_get_module(builder), llvm::Intrinsic::cttz,
+        {builder.getInt64Ty()});
+    return builder.CreateCall(
+        llvm_cttz, {params[0], builder.getFalse() /*is_zero_undef*/});
   } else if (name == "__builtin_char_eq") {
     /* scheme({}, {}, type_arrows({Int, Int, Bool})) */
     return builder.CreateZExt(builder.CreateICmpEQ(params[0], params[1]),
@@ -649,21 +696,20 @@ llvm::Value *gen_builtin(llvm::IRBuilder<> &builder,
   } else if (name == "__builtin_calloc") {
     /* scheme({"a"}, {}, type_arrows({Int, tp_a})) */
     auto llvm_module = llvm_get_module(builder);
-    llvm::Type *param_types[] = {builder.getInt64Ty()};
 
     assert(params.size() == 1);
 
-    auto ffi_function = llvm::cast<llvm::Function>(
-        llvm_module
-            ->getOrInsertFunction("zion_malloc",
-                                  llvm::FunctionType::get(
-                                      builder.getInt8Ty()->getPointerTo(),
-                                      llvm::ArrayRef<llvm::Type *>(param_types),
-                                      false /*isVarArg*/))
-            .getCallee());
+    /* arrays of scalars (strings, numeric buffers, etc...) don't need to be
+     * scanned by the collector */
+    llvm::Type *llvm_type = get_llvm_type(builder, type_env, type_builtin);
+    auto ffi_function = llvm_get_alloc_function(
+        builder, llvm_module,
+        !llvm_type_contains_pointers(
+            llvm_type->getPointerElementType()) /*atomic*/);
+    llvm_profile_alloc_site(builder, llvm_module, id.location, "calloc",
+                            params[0]);
     return llvm_maybe_pointer_cast(
-        builder, builder.CreateCall(ffi_function, params),
-        get_llvm_type(builder, type_env, type_builtin));
+        builder, builder.CreateCall(ffi_function, params), llvm_type);
   } else if (name == "__builtin_store_ref") {
     /* scheme({"a"}, {}, type_arrows({
      * type_operator(type_id(make_iid(REF_TYPE_OPERATOR)), tv_a), tv_a,
@@ -762,6 +808,23 @@ llvm::Value *gen_builtin(llvm::IRBuilder<> &builder,
   return nullptr;
 }
 
+void set_function_attributes(llvm::Function *llvm_function, int attributes) {
+  if (attributes & ast::fa_inline) {
+    llvm_function->addFnAttr(llvm::Attribute::AlwaysInline);
+  }
+  if (attributes & ast::fa_noinline) {
+    llvm_function->addFnAttr(llvm::Attribute::NoInline);
+  }
+  if (attributes & ast::fa_cold) {
+    llvm_function->addFnAttr(llvm::Attribute::Cold);
+  }
+  if (attributes & ast::fa_hot) {
+    /* LLVM 10 has no hot attribute, so the best we can do is to nudge the
+     * inliner. */
+    llvm_function->addFnAttr(llvm::Attribute::InlineHint);
+  }
+}
+
 void gen_lambda(std::string name,
                 llvm::IRBuilder<> &builder,
                 llvm::Module *llvm_module,
@@ -794,9 +857,10 @@ void gen_lambda(std::string name,
                      llvm_print(llvm_function_type).c_str()));
 
   llvm::Function *llvm_function = llvm::Function::Create(
-      llvm_function_type, llvm::Function::ExternalLinkage, name,
+      llvm_function_type, llvm::Function::InternalLinkage, name,
       llvm_module != nullptr ? llvm_module : llvm_get_module(builder));
   llvm_function->setDoesNotThrow();
+  set_function_attributes(llvm_function, lambda->attributes);
 
   llvm::BasicBlock *block = llvm::BasicBlock::Create(builder.getContext(),
                                                      "entry", llvm_function);
@@ -869,7 +933,8 @@ void gen_lambda(std::string name,
                                     builder.getInt8Ty()->getPointerTo())})),
         true /*is_constant*/);
   } else {
-    closure = llvm_tuple_alloc(builder, llvm_module, llvm_dims);
+    closure = llvm_tuple_alloc(builder, llvm_module, llvm_dims,
+                               lambda->get_location(), "closure");
     opaque_closure = builder.CreateBitCast(
         closure, llvm_closure_type->getPointerTo(),
         string_format("opaque_closure{%s}",
@@ -902,10 +967,32 @@ void gen_lambda(std::string name,
     }
 
     assert(type_terms.size() - 1 == lambda->vars.size());
+    std::unique_ptr<TailRecursion> tail_recursion;
+    if (closure == nullptr) {
+      /* capture-free functions are called directly, so we can turn their
+       * self-recursive tail calls into loops. bind the params to phi nodes
+       * at the top of the loop. if no such tail calls show up, this gets
+       * folded back into the entry block below. */
+      tail_recursion = std::make_unique<TailRecursion>();
+      tail_recursion->llvm_function = llvm_function;
+      tail_recursion->loop_block = llvm::BasicBlock::Create(
+          builder.getContext(), "tailrecurse", llvm_function);
+      builder.CreateBr(tail_recursion->loop_block);
+      builder.SetInsertPoint(tail_recursion->loop_block);
+    }
+
     auto args_iter = llvm_function->args().begin();
     for (size_t i = 0; i < type_terms.size() - 1; ++i) {
+      llvm::Value *llvm_param = &*args_iter++;
+      if (tail_recursion != nullptr) {
+        llvm::PHINode *llvm_phi = builder.CreatePHI(llvm_param->getType(), 2,
+                                                    lambda->vars[i].name);
+        llvm_phi->addIncoming(llvm_param, block);
+        tail_recursion->llvm_params.push_back(llvm_phi);
+        llvm_param = llvm_phi;
+      }
       set_env_var(new_env_locals, lambda->vars[i].name, type_terms[i],
-                  &*args_iter++);
+                  llvm_param);
     }
 
     if (closure != nullptr) {
@@ -940,6 +1027,7 @@ void gen_lambda(std::string name,
     }
 
     DeferGuard defer_guard(lambda->get_location(), nullptr, dt_function);
+    defer_guard.tail_recursion = tail_recursion.get();
     debug_above(3, log("generating body for %s = %s", name.c_str(),
                        lambda->body->str().c_str()));
     /* now build the body of the function */
@@ -954,6 +1042,17 @@ void gen_lambda(std::string name,
       builder.CreateRet(
           llvm::Constant::getNullValue(builder.getInt8Ty()->getPointerTo()));
     }
+
+    if (tail_recursion != nullptr &&
+        !llvm::pred_empty(tail_recursion->loop_block) &&
+        tail_recursion->loop_block->getSinglePredecessor() == block) {
+      /* there were no self-recursive tail calls, so undo the loop */
+      for (auto llvm_phi : tail_recursion->llvm_params) {
+        llvm_phi->replaceAllUsesWith(llvm_phi->getIncomingValue(0));
+        llvm_phi->eraseFromParent();
+      }
+      llvm::MergeBlockIntoPredecessor(tail_recursion->loop_block);
+    }
     llvm_verify_function(INTERNAL_LOC(), llvm_function);
   }
 }
@@ -1005,6 +1104,138 @@ ResolutionStatus gen_literal(std::string name,
   throw user_error(INTERNAL_LOC(), "compiler error");
 }
 
+typedef std::unordered_map<std::string, llvm::Constant *> ConstantEnv;
+
+/* bounds how deeply gen_constant will evaluate through function calls */
+const int max_constant_call_depth = 16;
+
+llvm::Constant *gen_constant(llvm::IRBuilder<> &builder,
+                             llvm::Module *llvm_module,
+                             const ast::Expr *expr,
+                             const TrackedTypes &typing,
+                             const types::TypeEnv &type_env,
+                             const GenEnv &gen_env_globals,
+                             const DefinitionLookup &lookup_definition,
+                             const ConstantEnv &constant_env,
+                             int depth) {
+  auto type = get(typing, expr, {});
+  if (type == nullptr) {
+    return nullptr;
+  }
+
+  if (auto literal = dcast<const ast::Literal *>(expr)) {
+    llvm::Value *llvm_value = nullptr;
+    Publishable publishable("constant literal", &llvm_value);
+    gen_literal("", builder, literal, type, &publishable);
+    return llvm::dyn_cast_or_null<llvm::Constant>(llvm_value);
+  } else if (auto var = dcast<const ast::Var *>(expr)) {
+    auto iter = constant_env.find(var->id.name);
+    if (iter != constant_env.end()) {
+      return iter->second;
+    }
+    /* another global. this only folds if that global folded too. */
+    return llvm::dyn_cast_or_null<llvm::Constant>(
+        maybe_get_env_var(builder, gen_env_globals, var->id, type));
+  } else if (auto tuple = dcast<const ast::Tuple *>(expr)) {
+    std::vector<llvm::Constant *> llvm_dims;
+    for (auto dim : tuple->dims) {
+      llvm::Constant *llvm_dim = gen_constant(
+          builder, llvm_module, dim, typing, type_env, gen_env_globals,
+          lookup_definition, constant_env, depth);
+      if (llvm_dim == nullptr) {
+        return nullptr;
+      }
+      llvm_dims.push_back(llvm_dim);
+    }
+    if (llvm_dims.size() == 0) {
+      return llvm::Constant::getNullValue(builder.getInt8Ty()->getPointerTo());
+    }
+    std::vector<llvm::Type *> llvm_dim_types;
+    for (auto llvm_dim : llvm_dims) {
+      llvm_dim_types.push_back(llvm_dim->getType());
+    }
+    llvm::StructType *llvm_tuple_type = llvm_create_struct_type(
+        builder, llvm_dim_types);
+    /* tuples hold refs which may be written to later, so this can't go into
+     * read-only memory */
+    return llvm_get_global(
+        llvm_module, "tuple",
+        llvm::ConstantStruct::get(llvm_tuple_type, llvm_dims),
+        false /*is_constant*/);
+  } else if (auto as = dcast<const ast::As *>(expr)) {
+    assert(as->force_cast);
+    llvm::Constant *llvm_value = gen_constant(
+        builder, llvm_module, as->expr, typing, type_env, gen_env_globals,
+        lookup_definition, constant_env, depth);
+    if (llvm_value == nullptr) {
+      return nullptr;
+    }
+    auto cast_type = get_llvm_type(builder, type_env, as->type);
+    if (cast_type == llvm_value->getType()) {
+      return llvm_value;
+    }
+    /* the builder folds casts of constants */
+    return llvm::cast<llvm::Constant>(
+        builder.CreateBitOrPointerCast(llvm_value, cast_type));
+  } else if (auto application = dcast<const ast::Application *>(expr)) {
+    /* we can evaluate calls to global functions whose body just returns an
+     * expression we can evaluate. that covers all the data constructors. */
+    auto callee = dcast<const ast::Var *>(application->a);
+    if (callee == nullptr || depth >= max_constant_call_depth ||
+        in(callee->id.name, constant_env)) {
+      return nullptr;
+    }
+    const Translation *translation = lookup_definition(
+        callee->id.name, get(typing, application->a, {}));
+    if (translation == nullptr) {
+      return nullptr;
+    }
+    auto lambda = dcast<const ast::Lambda *>(translation->expr);
+    if (lambda == nullptr || lambda->vars.size() != application->params.size()) {
+      return nullptr;
+    }
+    const ast::Expr *body = lambda->body;
+    if (auto block = dcast<const ast::Block *>(body)) {
+      if (block->statements.size() != 1) {
+        return nullptr;
+      }
+      body = block->statements[0];
+    }
+    auto return_ = dcast<const ast::ReturnStatement *>(body);
+    if (return_ == nullptr) {
+      return nullptr;
+    }
+
+    ConstantEnv new_constant_env;
+    for (size_t i = 0; i < application->params.size(); ++i) {
+      llvm::Constant *llvm_param = gen_constant(
+          builder, llvm_module, application->params[i], typing, type_env,
+          gen_env_globals, lookup_definition, constant_env, depth);
+      if (llvm_param == nullptr) {
+        return nullptr;
+      }
+      new_constant_env[lambda->vars[i].name] = llvm_param;
+    }
+    return gen_constant(builder, llvm_module, return_->value,
+                        translation->typing, type_env, gen_env_globals,
+                        lookup_definition, new_constant_env, depth + 1);
+  }
+
+  /* anything else might have side effects */
+  return nullptr;
+}
+
+llvm::Constant *gen_constant(llvm::IRBuilder<> &builder,
+                             llvm::Module *llvm_module,
+                             const ast::Expr *expr,
+                             const TrackedTypes &typing,
+                             const types::TypeEnv &type_env,
+                             const GenEnv &gen_env_globals,
+                             const DefinitionLookup &lookup_definition) {
+  return gen_constant(builder, llvm_module, expr, typing, type_env,
+                      gen_env_globals, lookup_definition, {}, 0 /*depth*/);
+}
+
 ResolutionStatus gen(llvm::IRBuilder<> &builder,
                      llvm::Module *llvm_module,
                      DeferGuard *defer_guard,
@@ -1048,6 +1279,105 @@ llvm::Value *gen(llvm::IRBuilder<> &builder,
   return llvm_value;
 }
 
+llvm::Value *gen_static_array(llvm::IRBuilder<> &builder,
+                              llvm::Module *llvm_module,
+                              const ast::Builtin *builtin,
+                              const TrackedTypes &typing,
+                              const types::TypeEnv &type_env) {
+  /* the parser emits __builtin_static_array((x, y, z)) for array literals
+   * whose elements are all literals. rather than building the tuple, lay the
+   * elements out as an array in read-only memory. */
+  auto tuple = builtin->exprs.size() == 1
+                   ? dcast<const ast::Tuple *>(builtin->exprs[0])
+                   : nullptr;
+  if (tuple == nullptr || tuple->dims.size() == 0) {
+    throw user_error(builtin->get_location(),
+                     "__builtin_static_array expects a non-empty tuple");
+  }
+
+  std::vector<llvm::Constant *> llvm_elements;
+  for (auto dim : tuple->dims) {
+    auto literal = dcast<const ast::Literal *>(dim);
+    llvm::Value *llvm_value = nullptr;
+    if (literal != nullptr) {
+      Publishable publishable("static array element", &llvm_value);
+      gen_literal("", builder, literal, typing.at(dim), &publishable);
+    }
+    auto llvm_element = llvm::dyn_cast_or_null<llvm::Constant>(llvm_value);
+    if (llvm_element == nullptr ||
+        (llvm_elements.size() != 0 &&
+         llvm_element->getType() != llvm_elements[0]->getType())) {
+      throw user_error(dim->get_location(),
+                       "__builtin_static_array elements must be literals of "
+                       "the same type");
+    }
+    llvm_elements.push_back(llvm_element);
+  }
+
+  llvm::ArrayType *llvm_array_type = llvm::ArrayType::get(
+      llvm_elements[0]->getType(), llvm_elements.size());
+  llvm::GlobalVariable *llvm_array = llvm_get_global(
+      llvm_module, "static_array",
+      llvm::ConstantArray::get(llvm_array_type, llvm_elements),
+      true /*is_constant*/);
+  return llvm_maybe_pointer_cast(
+      builder, llvm_array,
+      get_llvm_type(builder, type_env, typing.at(builtin)));
+}
+
+void gen_tail_call(llvm::IRBuilder<> &builder,
+                   llvm::Module *llvm_module,
+                   DeferGuard *defer_guard,
+                   llvm::BasicBlock *break_to_block,
+                   llvm::BasicBlock *continue_to_block,
+                   const ast::Application *application,
+                   const TrackedTypes &typing,
+                   const types::TypeEnv &type_env,
+                   const GenEnv &gen_env_globals,
+                   const GenLocalEnv &gen_env_locals,
+                   const std::unordered_set<std::string> &globals) {
+  /* emit "return f(...)". the call is only in tail position when there are no
+   * deferred calls left to be made after it returns. */
+  llvm::Value *closure = gen(builder, llvm_module, defer_guard, break_to_block,
+                             continue_to_block, application->a, typing,
+                             type_env, gen_env_globals, gen_env_locals,
+                             globals);
+
+  std::vector<llvm::Value *> args;
+  for (auto &param : application->params) {
+    args.push_back(gen(builder, llvm_module, defer_guard, break_to_block,
+                       continue_to_block, param, typing, type_env,
+                       gen_env_globals, gen_env_locals, globals));
+  }
+
+  bool is_tail_call = !defer_guard->has_deferred(dt_function);
+  TailRecursion *tail_recursion = defer_guard->get_tail_recursion();
+  if (is_tail_call && tail_recursion != nullptr &&
+      llvm_get_static_closure_function(closure) ==
+          tail_recursion->llvm_function) {
+    /* this is a self-recursive tail call. rebind the params and jump back to
+     * the top of the function instead of growing the stack. */
+    debug_above(4, log_location(application->get_location(),
+                                "lowering self-recursive tail call to %s",
+                                application->a->str().c_str()));
+    assert(args.size() == tail_recursion->llvm_params.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+      tail_recursion->llvm_params[i]->addIncoming(args[i],
+                                                  builder.GetInsertBlock());
+    }
+    builder.CreateBr(tail_recursion->loop_block);
+    return;
+  }
+
+  llvm::Value *llvm_value = llvm_create_closure_callsite(
+      application->get_location(), builder, closure, args);
+  defer_guard->call_deferred(builder, dt_function);
+  if (is_tail_call) {
+    llvm_mark_tail_call(llvm::cast<llvm::CallInst>(llvm_value));
+  }
+  builder.CreateRet(llvm_value);
+}
+
 ResolutionStatus gen(std::string name,
                      llvm::IRBuilder<> &builder,
                      llvm::Module *llvm_module,
@@ -1299,6 +1629,14 @@ ResolutionStatus gen(std::string name,
 
       return rs_cache_resolution;
     } else if (auto return_ = dcast<const ast::ReturnStatement *>(expr)) {
+      if (auto application = dcast<const ast::Application *>(
+              return_->value)) {
+        gen_tail_call(builder, llvm_module, defer_guard, break_to_block,
+                      continue_to_block, application, typing, type_env,
+                      gen_env_globals, gen_env_locals, globals);
+        return rs_cache_resolution;
+      }
+
       llvm::Value *llvm_value = nullptr;
       gen(builder, llvm_module, defer_guard, break_to_block, continue_to_block,
           return_->value, typing, type_env, gen_env_globals, gen_env_locals,
@@ -1333,7 +1671,8 @@ ResolutionStatus gen(std::string name,
                                  type_env, gen_env_globals, gen_env_locals,
                                  globals));
       }
-      publish(llvm_tuple_alloc(builder, llvm_module, dim_values));
+      publish(llvm_tuple_alloc(builder, llvm_module, dim_values,
+                               tuple->get_location(), "tuple"));
       return rs_cache_resolution;
     } else if (auto tuple_deref = dcast<const ast::TupleDeref *>(expr)) {
       auto td = gen(builder, llvm_module, defer_guard, break_to_block,
@@ -1409,6 +1748,12 @@ ResolutionStatus gen(std::string name,
                          "__builtin_ffi_* is deprecated");
       }
 
+      if (builtin->var->id.name == "__builtin_static_array") {
+        publish(gen_static_array(builder, llvm_module, builtin, typing,
+                                 type_env));
+        return rs_cache_resolution;
+      }
+
       for (auto expr : builtin->exprs) {
         llvm_values.push_back(gen(builder, llvm_module, defer_guard,
                                   break_to_block, continue_to_block, expr,
@@ -4,6 +4,7 @@
 #include "ast.h"
 #include "llvm_utils.h"
 #include "resolver.h"
+#include "translate.h"
 #include "types.h"
 #include "unification.h"
 #include "user_error.h"
@@ -46,6 +47,23 @@ ResolutionStatus gen(std::string name,
                      const GenLocalEnv &gen_env_locals,
                      const std::unordered_set<std::string> &globals,
                      Publisher *publisher);
+
+/* finds the translation of the global definition name :: type, or returns
+ * nullptr */
+typedef std::function<const Translation *(std::string name, types::Ref type)>
+    DefinitionLookup;
+
+/* try to evaluate the initializer of a global at compile time. literals,
+ * tuples and calls to data constructors (or other functions that simply
+ * return such values) are turned into static data. returns nullptr when expr
+ * needs to run at program startup. */
+llvm::Constant *gen_constant(llvm::IRBuilder<> &builder,
+                             llvm::Module *llvm_module,
+                             const ast::Expr *expr,
+                             const TrackedTypes &typing,
+                             const types::TypeEnv &type_env,
+                             const GenEnv &gen_env_globals,
+                             const DefinitionLookup &lookup_definition);
 } // namespace gen
 
 } // namespace zion
@@ -253,7 +253,7 @@ const Expr *rewrite_expr(const RewriteImportRules &rewrite_import_rules,
         (lambda->return_type != nullptr)
             ? lambda->return_type->rewrite_ids(rewrite_import_rules)
             : nullptr,
-        rewrite_expr(rewrite_import_rules, lambda->body));
+        rewrite_expr(rewrite_import_rules, lambda->body), lambda->attributes);
   } else if (auto application = dcast<const Application *>(expr)) {
     return rewrite_application(rewrite_import_rules, application);
   } else if (auto let = dcast<const Let *>(expr)) {
@@ -371,6 +371,24 @@ void llvm_verify_module(llvm::Module &llvm_module) {
   // std::cerr << ss.str() << std::endl;
 }
 
+LLVMModuleSize llvm_get_module_size(const llvm::Module &llvm_module) {
+  LLVMModuleSize module_size;
+  for (auto &llvm_function : llvm_module) {
+    if (llvm_function.isDeclaration()) {
+      continue;
+    }
+    ++module_size.functions;
+    module_size.instructions += llvm_function.getInstructionCount();
+  }
+  return module_size;
+}
+
+void llvm_merge_functions(llvm::Module &llvm_module) {
+  llvm::legacy::PassManager pass_manager;
+  pass_manager.add(llvm::createMergeFunctionsPass());
+  pass_manager.run(llvm_module);
+}
+
 llvm::Constant *llvm_sizeof_type(llvm::IRBuilder<> &builder,
                                  llvm::Type *llvm_type) {
   llvm::StructType *llvm_struct_type = llvm::dyn_cast<llvm::StructType>(
@@ -642,9 +660,281 @@ llvm::Constant *llvm_get_zero_value(llvm::Type *llvm_type) {
   }
 }
 
+static bool llvm_is_heap_pointer_type(llvm::Type *llvm_type) {
+  /* function pointers point at code, never into the heap */
+  return llvm_type->isPointerTy() &&
+         !llvm_type->getPointerElementType()->isFunctionTy();
+}
+
+bool llvm_type_contains_pointers(llvm::Type *llvm_type) {
+  if (llvm_type->isPointerTy()) {
+    return llvm_is_heap_pointer_type(llvm_type);
+  } else if (auto llvm_struct_type = llvm::dyn_cast<llvm::StructType>(
+                 llvm_type)) {
+    for (auto llvm_element_type : llvm_struct_type->elements()) {
+      if (llvm_type_contains_pointers(llvm_element_type)) {
+        return true;
+      }
+    }
+    return false;
+  } else if (auto llvm_array_type = llvm::dyn_cast<llvm::ArrayType>(
+                 llvm_type)) {
+    return llvm_type_contains_pointers(llvm_array_type->getElementType());
+  } else if (auto llvm_vector_type = llvm::dyn_cast<llvm::VectorType>(
+                 llvm_type)) {
+    return llvm_type_contains_pointers(llvm_vector_type->getElementType());
+  }
+  return false;
+}
+
+/* these must match zion_rt.c */
+static const int zion_granule_shift = 4;
+static const int zion_granule_size = 1 << zion_granule_shift;
+static const int zion_small_object_classes = 16;
+
+static llvm::Function *llvm_get_malloc_inline(llvm::Module *llvm_module) {
+  /* emits the allocation fast path: pop an object off of the free list for
+   * its size class, which the runtime refills in batches from the collector.
+   * this is always inlined into the allocation sites. */
+  const char *name = "zion_malloc_inline";
+  if (auto llvm_function = llvm_module->getFunction(name)) {
+    return llvm_function;
+  }
+
+  llvm::LLVMContext &context = llvm_module->getContext();
+  llvm::IRBuilder<> builder(context);
+  llvm::Type *llvm_void_ptr_type = builder.getInt8Ty()->getPointerTo();
+  llvm::Type *alloc_terms[] = {builder.getInt64Ty()};
+  llvm::FunctionType *llvm_alloc_type = llvm::FunctionType::get(
+      llvm_void_ptr_type, alloc_terms, false /*isVarArg*/);
+
+  auto llvm_malloc = llvm::cast<llvm::Function>(
+      llvm_module->getOrInsertFunction("zion_malloc", llvm_alloc_type)
+          .getCallee());
+  auto llvm_refill = llvm::cast<llvm::Function>(
+      llvm_module->getOrInsertFunction("zion_malloc_refill", llvm_alloc_type)
+          .getCallee());
+  llvm_refill->addFnAttr(llvm::Attribute::Cold);
+  llvm_refill->addFnAttr(llvm::Attribute::NoInline);
+
+  llvm::ArrayType *llvm_free_lists_type = llvm::ArrayType::get(
+      llvm_void_ptr_type, zion_small_object_classes + 1);
+  llvm::Constant *llvm_free_lists = llvm_module->getOrInsertGlobal(
+      "zion_free_lists", llvm_free_lists_type);
+
+  llvm::Function *llvm_function = llvm::Function::Create(
+      llvm_alloc_type, llvm::Function::InternalLinkage, name, llvm_module);
+  llvm_function->setDoesNotThrow();
+  llvm_function->addFnAttr(llvm::Attribute::AlwaysInline);
+
+  llvm::BasicBlock *entry_block = llvm::BasicBlock::Create(context, "entry",
+                                                           llvm_function);
+  llvm::BasicBlock *small_block = llvm::BasicBlock::Create(
+      context, "small_object", llvm_function);
+  llvm::BasicBlock *pop_block = llvm::BasicBlock::Create(context, "pop",
+                                                         llvm_function);
+  llvm::BasicBlock *refill_block = llvm::BasicBlock::Create(context, "refill",
+                                                            llvm_function);
+  llvm::BasicBlock *large_block = llvm::BasicBlock::Create(
+      context, "large_object", llvm_function);
+  llvm::MDBuilder md_builder(context);
+
+  llvm::Value *llvm_size = &*llvm_function->arg_begin();
+
+  /* zero-sized requests wrap around and take the slow path */
+  builder.SetInsertPoint(entry_block);
+  builder.CreateCondBr(
+      builder.CreateICmpULT(
+          builder.CreateSub(llvm_size, builder.getInt64(1)),
+          builder.getInt64(zion_granule_size * zion_small_object_classes)),
+      small_block, large_block, md_builder.createBranchWeights(100, 1));
+
+  builder.SetInsertPoint(small_block);
+  llvm::Value *llvm_size_class = builder.CreateLShr(
+      builder.CreateAdd(llvm_size, builder.getInt64(zion_granule_size - 1)),
+      builder.getInt64(zion_granule_shift));
+  llvm::Value *llvm_gep_path[] = {builder.getInt64(0), llvm_size_class};
+  llvm::Value *llvm_free_list = builder.CreateInBoundsGEP(
+      llvm_free_lists_type, llvm_free_lists, llvm_gep_path);
+  llvm::Value *llvm_object = builder.CreateLoad(llvm_void_ptr_type,
+                                                llvm_free_list);
+  builder.CreateCondBr(
+      builder.CreateIsNull(llvm_object), refill_block, pop_block,
+      md_builder.createBranchWeights(1, 100));
+
+  /* the first word of each free object links to the next one */
+  builder.SetInsertPoint(pop_block);
+  llvm::Value *llvm_link = builder.CreateBitCast(
+      llvm_object, llvm_void_ptr_type->getPointerTo());
+  builder.CreateStore(builder.CreateLoad(llvm_void_ptr_type, llvm_link),
+                      llvm_free_list);
+  builder.CreateStore(llvm::Constant::getNullValue(llvm_void_ptr_type),
+                      llvm_link);
+  builder.CreateRet(llvm_object);
+
+  builder.SetInsertPoint(refill_block);
+  builder.CreateRet(builder.CreateCall(llvm_refill, {llvm_size_class}));
+
+  builder.SetInsertPoint(large_block);
+  builder.CreateRet(builder.CreateCall(llvm_malloc, {llvm_size}));
+  return llvm_function;
+}
+
+llvm::Function *llvm_get_alloc_function(llvm::IRBuilder<> &builder,
+                                        llvm::Module *llvm_module,
+                                        bool atomic) {
+  if (!atomic) {
+    return llvm_get_malloc_inline(llvm_module);
+  }
+  llvm::Type *alloc_terms[] = {builder.getInt64Ty()};
+  return llvm::cast<llvm::Function>(
+      llvm_module
+          ->getOrInsertFunction(
+              "zion_malloc_atomic",
+              llvm::FunctionType::get(builder.getInt8Ty()->getPointerTo(),
+                                      alloc_terms, false /*isVarArg*/))
+          .getCallee());
+}
+
+static bool llvm_get_gc_bitmap(llvm::StructType *llvm_struct_type,
+                               uint64_t &bitmap,
+                               int &word_count) {
+  /* find which words of the struct hold heap pointers, laying out the fields
+   * with natural alignment as the 64-bit C ABIs do. gives up on anything we
+   * can't describe in a single bitmap word. */
+  const int word_size = 8;
+  int offset = 0;
+  bitmap = 0;
+  for (auto llvm_element_type : llvm_struct_type->elements()) {
+    int size;
+    if (llvm_element_type->isPointerTy() || llvm_element_type->isDoubleTy()) {
+      size = 8;
+    } else if (llvm_element_type->isFloatTy()) {
+      size = 4;
+    } else if (llvm_element_type->isIntegerTy()) {
+      size = std::max(1u, llvm_element_type->getIntegerBitWidth() / 8);
+    } else {
+      return false;
+    }
+    offset = (offset + size - 1) / size * size;
+    if (llvm_is_heap_pointer_type(llvm_element_type)) {
+      if (offset / word_size >= 64) {
+        return false;
+      }
+      bitmap |= uint64_t(1) << (offset / word_size);
+    }
+    offset += size;
+  }
+  word_count = (offset + word_size - 1) / word_size;
+  return word_count <= 64;
+}
+
+static llvm::Value *llvm_create_typed_alloc(llvm::IRBuilder<> &builder,
+                                            llvm::Module *llvm_module,
+                                            llvm::StructType *llvm_tuple_type,
+                                            uint64_t bitmap,
+                                            int word_count) {
+  /* share one layout record per distinct bitmap */
+  std::string layout_name = string_format("gc_layout.%d.%llx", word_count,
+                                          (unsigned long long)bitmap);
+  llvm::StructType *llvm_layout_type = llvm::StructType::get(
+      builder.getInt64Ty(), builder.getInt64Ty(), builder.getInt64Ty());
+  llvm::GlobalVariable *llvm_layout = llvm_module->getNamedGlobal(layout_name);
+  if (llvm_layout == nullptr) {
+    llvm_layout = llvm_get_global(
+        llvm_module, layout_name,
+        llvm::ConstantStruct::get(
+            llvm_layout_type,
+            {builder.getInt64(0), builder.getInt64(bitmap),
+             builder.getInt64(word_count)}),
+        false /*is_constant*/);
+  }
+
+  llvm::Type *alloc_terms[] = {builder.getInt64Ty(),
+                               llvm_layout_type->getPointerTo()};
+  auto llvm_alloc_func_decl = llvm::cast<llvm::Function>(
+      llvm_module
+          ->getOrInsertFunction(
+              "zion_malloc_typed",
+              llvm::FunctionType::get(builder.getInt8Ty()->getPointerTo(),
+                                      alloc_terms, false /*isVarArg*/))
+          .getCallee());
+  return builder.CreateCall(
+      llvm_alloc_func_decl,
+      std::vector<llvm::Value *>{llvm_sizeof_type(builder, llvm_tuple_type),
+                                 llvm_layout});
+}
+
+/* building with ZION_ALLOC_PROFILE set counts every heap allocation against
+ * the source location that asked for it, and the stack of call sites that
+ * led there */
+static const bool alloc_profile = getenv("ZION_ALLOC_PROFILE") != nullptr;
+
+void llvm_profile_alloc_site(llvm::IRBuilder<> &builder,
+                             llvm::Module *llvm_module,
+                             const Location &location,
+                             std::string kind,
+                             llvm::Value *llvm_size) {
+  if (!alloc_profile) {
+    return;
+  }
+
+  llvm::Type *profile_terms[] = {builder.getInt8Ty()->getPointerTo(),
+                                 builder.getInt64Ty()};
+  auto llvm_profile_func_decl = llvm::cast<llvm::Function>(
+      llvm_module
+          ->getOrInsertFunction(
+              "zion_alloc_profile",
+              llvm::FunctionType::get(builder.getVoidTy(), profile_terms,
+                                      false /*isVarArg*/))
+          .getCallee());
+  builder.CreateCall(
+      llvm_profile_func_decl,
+      std::vector<llvm::Value *>{
+          llvm_create_global_string_constant(
+              builder, *llvm_module, location.repr() + ";" + kind),
+          llvm_size});
+}
+
+static void llvm_profile_call_site(llvm::IRBuilder<> &builder,
+                                   const Location &location,
+                                   bool entering) {
+  /* keeps the runtime's stack of call sites in step with the real one, so
+   * that an allocation deep inside the library (an alloc, a data ctor, a
+   * string concat) is reported under the call in the program that led to
+   * it */
+  llvm::Module *llvm_module = llvm_get_module(builder);
+  llvm::Function *llvm_func_decl;
+  if (entering) {
+    llvm::Type *terms[] = {builder.getInt8Ty()->getPointerTo()};
+    llvm_func_decl = llvm::cast<llvm::Function>(
+        llvm_module
+            ->getOrInsertFunction(
+                "zion_alloc_profile_enter",
+                llvm::FunctionType::get(builder.getVoidTy(), terms,
+                                        false /*isVarArg*/))
+            .getCallee());
+    builder.CreateCall(llvm_func_decl,
+                       std::vector<llvm::Value *>{
+                           llvm_create_global_string_constant(
+                               builder, *llvm_module, location.repr())});
+  } else {
+    llvm_func_decl = llvm::cast<llvm::Function>(
+        llvm_module
+            ->getOrInsertFunction(
+                "zion_alloc_profile_leave",
+                llvm::FunctionType::get(builder.getVoidTy(),
+                                        false /*isVarArg*/))
+            .getCallee());
+    builder.CreateCall(llvm_func_decl);
+  }
+}
+
 llvm::Value *llvm_tuple_alloc(llvm::IRBuilder<> &builder,
                               llvm::Module *llvm_module,
-                              const std::vector<llvm::Value *> llvm_dims) {
+                              const std::vector<llvm::Value *> llvm_dims,
+                              const Location &location,
+                              std::string kind) {
   if (llvm_dims.size() == 0) {
     return llvm::Constant::getNullValue(builder.getInt8Ty()->getPointerTo());
   }
@@ -668,21 +958,33 @@ llvm::Value *llvm_tuple_alloc(llvm::IRBuilder<> &builder,
   } else {
     assert(llvm_module == llvm_get_module(builder));
 
-    llvm::Type *alloc_terms[] = {builder.getInt64Ty()};
     debug_above(6, log("need to allocate a tuple of type %s",
                        llvm_print(llvm_tuple_type).c_str()));
-    auto llvm_alloc_func_decl = llvm::cast<llvm::Function>(
-        llvm_module
-            ->getOrInsertFunction(
-                "zion_malloc",
-                llvm::FunctionType::get(builder.getInt8Ty()->getPointerTo(),
-                                        alloc_terms, false /*isVarArg*/))
-            .getCallee());
+    llvm_profile_alloc_site(builder, llvm_module, location, kind,
+                            llvm_sizeof_type(builder, llvm_tuple_type));
+    uint64_t bitmap;
+    int word_count;
+    llvm::Value *llvm_allocation;
+    if (llvm_type_contains_pointers(llvm_tuple_type) &&
+        llvm_get_gc_bitmap(llvm_tuple_type, bitmap, word_count) &&
+        bitmap != (word_count == 64 ? ~uint64_t(0)
+                                    : (uint64_t(1) << word_count) - 1)) {
+      /* some of the words are scalars, so tell the collector where the
+       * pointers are */
+      llvm_allocation = llvm_create_typed_alloc(builder, llvm_module,
+                                                llvm_tuple_type, bitmap,
+                                                word_count);
+    } else {
+      auto llvm_alloc_func_decl = llvm_get_alloc_function(
+          builder, llvm_module,
+          !llvm_type_contains_pointers(llvm_tuple_type) /*atomic*/);
+      llvm_allocation = builder.CreateCall(
+          llvm_alloc_func_decl,
+          std::vector<llvm::Value *>{
+              llvm_sizeof_type(builder, llvm_tuple_type)});
+    }
     llvm::Value *llvm_allocated_tuple = builder.CreateBitCast(
-        builder.CreateCall(llvm_alloc_func_decl,
-                           std::vector<llvm::Value *>{
-                               llvm_sizeof_type(builder, llvm_tuple_type)}),
-        llvm_tuple_type->getPointerTo());
+        llvm_allocation, llvm_tuple_type->getPointerTo());
 #ifdef ZION_DEBUG
     llvm_allocated_tuple->setName(
         string_format("tuple/%d", int(llvm_dims.size())));
@@ -775,13 +1077,99 @@ void destructure_closure(llvm::IRBuilder<> &builder,
   dbg_when(llvm_print(*llvm_function).find("badref") != std::string::npos);
 }
 
+llvm::Function *llvm_get_static_closure_function(llvm::Value *closure) {
+  /* closures without any captured variables are emitted by gen_lambda as
+   * constant globals of the form {function, null}. when we see one of those we
+   * know exactly which function will be called. */
+  auto llvm_global = llvm::dyn_cast<llvm::GlobalVariable>(
+      closure->stripPointerCasts());
+  if (llvm_global == nullptr || !llvm_global->isConstant() ||
+      !llvm_global->hasInitializer()) {
+    return nullptr;
+  }
+
+  auto llvm_closure_struct = llvm::dyn_cast<llvm::ConstantStruct>(
+      llvm_global->getInitializer());
+  if (llvm_closure_struct == nullptr ||
+      llvm_closure_struct->getNumOperands() != 2 ||
+      !llvm_closure_struct->getOperand(1)->isNullValue()) {
+    return nullptr;
+  }
+
+  auto llvm_function = llvm::dyn_cast<llvm::Function>(
+      llvm_closure_struct->getOperand(0)->stripPointerCasts());
+  if (llvm_function == nullptr) {
+    return nullptr;
+  }
+
+  /* stripPointerCasts also looks through as! casts, so the function we found
+   * may not take the arguments the callsite is about to pass. only call it
+   * directly when its type is the one the closure is used at. */
+  auto llvm_closure_ptr_type = llvm::dyn_cast<llvm::PointerType>(
+      closure->getType());
+  auto llvm_closure_type =
+      llvm_closure_ptr_type != nullptr
+          ? llvm::dyn_cast<llvm::StructType>(
+                llvm_closure_ptr_type->getElementType())
+          : nullptr;
+  if (llvm_closure_type == nullptr ||
+      llvm_closure_type->getNumElements() != 2 ||
+      !llvm_closure_type->getElementType(0)->isPointerTy() ||
+      llvm_closure_type->getElementType(0)->getPointerElementType() !=
+          llvm_function->getFunctionType()) {
+    return nullptr;
+  }
+  return llvm_function;
+}
+
+static bool llvm_types_match_for_musttail(llvm::Type *a, llvm::Type *b) {
+  /* musttail allows pointer types to differ in their pointee types */
+  return a == b || (a->isPointerTy() && b->isPointerTy() &&
+                    a->getPointerAddressSpace() == b->getPointerAddressSpace());
+}
+
+void llvm_mark_tail_call(llvm::CallInst *llvm_call) {
+  llvm::FunctionType *llvm_caller_type =
+      llvm_call->getFunction()->getFunctionType();
+  llvm::FunctionType *llvm_callee_type = llvm_call->getFunctionType();
+
+  bool prototypes_match =
+      llvm_caller_type->getNumParams() == llvm_callee_type->getNumParams() &&
+      llvm_caller_type->isVarArg() == llvm_callee_type->isVarArg() &&
+      llvm_types_match_for_musttail(llvm_caller_type->getReturnType(),
+                                    llvm_callee_type->getReturnType());
+  for (unsigned i = 0; prototypes_match && i < llvm_caller_type->getNumParams();
+       ++i) {
+    prototypes_match = llvm_types_match_for_musttail(
+        llvm_caller_type->getParamType(i), llvm_callee_type->getParamType(i));
+  }
+
+  /* musttail calls must be followed directly by the ret, which is not the
+   * case when the allocation profiler pops its call site after the call */
+  prototypes_match = prototypes_match && llvm_call->getNextNode() == nullptr;
+
+  /* Zion never passes stack memory to callees, so any call in tail position
+   * may be marked tail. When the prototypes line up, LLVM is able to
+   * guarantee it. */
+  llvm_call->setTailCallKind(prototypes_match ? llvm::CallInst::TCK_MustTail
+                                              : llvm::CallInst::TCK_Tail);
+}
+
 llvm::Value *llvm_create_closure_callsite(Location location,
                                           llvm::IRBuilder<> &builder,
                                           llvm::Value *closure,
                                           std::vector<llvm::Value *> args) {
   assert(builder.GetInsertBlock() != nullptr);
-  llvm::Value *llvm_function_to_call = nullptr;
-  destructure_closure(builder, closure, &llvm_function_to_call, nullptr);
+  llvm::Value *llvm_function_to_call = llvm_get_static_closure_function(
+      closure);
+  if (llvm_function_to_call != nullptr) {
+    /* this is a known call. skip loading the function pointer out of the
+     * closure so that LLVM sees a direct call (and can inline it.) */
+    debug_above(4, log("emitting direct call to %s",
+                       llvm_function_to_call->getName().str().c_str()));
+  } else {
+    destructure_closure(builder, closure, &llvm_function_to_call, nullptr);
+  }
 
   args.push_back(builder.CreateBitCast(
       closure, builder.getInt8Ty()->getPointerTo(), "closure_cast"));
@@ -790,13 +1178,20 @@ llvm::Value *llvm_create_closure_callsite(Location location,
                      llvm_print(llvm_function_to_call->getType()).c_str(),
                      llvm_print(args[0]->getType()).c_str(),
                      llvm_print(args[1]->getType()).c_str()));
-  return builder.CreateCall(llvm_function_to_call,
-                            llvm::ArrayRef<llvm::Value *>(args)
+  if (alloc_profile) {
+    llvm_profile_call_site(builder, location, true /*entering*/);
+  }
+  llvm::CallInst *llvm_call = builder.CreateCall(
+      llvm_function_to_call, llvm::ArrayRef<llvm::Value *>(args)
 #ifdef ZION_DEBUG
-                                ,
-                            string_format("call{%s}", location.repr().c_str())
+                                 ,
+      string_format("call{%s}", location.repr().c_str())
 #endif
   );
+  if (alloc_profile) {
+    llvm_profile_call_site(builder, location, false /*entering*/);
+  }
+  return llvm_call;
 }
 
 } // namespace zion
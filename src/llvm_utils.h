@@ -74,9 +74,27 @@ llvm::StructType *llvm_create_struct_type(
 llvm::StructType *llvm_create_struct_type(
     llvm::IRBuilder<> &builder,
     const std::vector<llvm::Value *> &llvm_dims);
+/* could a value of this type hold a pointer into the heap? */
+bool llvm_type_contains_pointers(llvm::Type *llvm_type);
+/* returns the inlined small object allocator (which falls back to
+ * zion_malloc), or zion_malloc_atomic when the memory will never hold pointers
+ * and therefore need not be scanned by the collector */
+llvm::Function *llvm_get_alloc_function(llvm::IRBuilder<> &builder,
+                                        llvm::Module *llvm_module,
+                                        bool atomic);
+/* counts an allocation of llvm_size bytes against location, and the stack of
+ * calls that led to it, when building with ZION_ALLOC_PROFILE set. otherwise
+ * does nothing */
+void llvm_profile_alloc_site(llvm::IRBuilder<> &builder,
+                             llvm::Module *llvm_module,
+                             const Location &location,
+                             std::string kind,
+                             llvm::Value *llvm_size);
 llvm::Value *llvm_tuple_alloc(llvm::IRBuilder<> &builder,
                               llvm::Module *llvm_module,
-                              const std::vector<llvm::Value *> llvm_dims);
+                              const std::vector<llvm::Value *> llvm_dims,
+                              const Location &location,
+                              std::string kind);
 llvm::Constant *llvm_sizeof_type(llvm::IRBuilder<> &builder,
                                  llvm::Type *llvm_type);
 llvm::Value *llvm_maybe_pointer_cast(llvm::IRBuilder<> &builder,
@@ -99,6 +117,17 @@ void check_struct_initialization(
 void llvm_verify_function(Location location, llvm::Function *llvm_function);
 void llvm_verify_module(llvm::Module &llvm_module);
 
+struct LLVMModuleSize {
+  int functions = 0;
+  int instructions = 0;
+};
+
+LLVMModuleSize llvm_get_module_size(const llvm::Module &llvm_module);
+
+/* runs LLVM's mergefunc pass, which folds functions with identical machine
+ * representations (pointer types are all considered equal) into one. */
+void llvm_merge_functions(llvm::Module &llvm_module);
+
 /* flags for llvm_create_if_branch that tell it whether to invoke release_vars
  * for either branch */
 
@@ -140,6 +169,14 @@ void explain(llvm::Type *llvm_type);
 std::vector<llvm::Type *> llvm_get_types(
     const std::vector<llvm::Value *> &llvm_values);
 
+/* returns the function behind a capture-free static closure, or nullptr if the
+ * closure must be dispatched through its function pointer at runtime */
+llvm::Function *llvm_get_static_closure_function(llvm::Value *closure);
+
+/* marks a call that is immediately followed by a ret of its value as a tail
+ * call. uses musttail when the caller and callee prototypes allow it. */
+void llvm_mark_tail_call(llvm::CallInst *llvm_call);
+
 llvm::Value *llvm_create_closure_callsite(Location location,
                                           llvm::IRBuilder<> &builder,
                                           llvm::Value *closure,
@@ -50,6 +50,9 @@ bool debug_specialized_env = getenv("SHOW_ENV2") != nullptr;
 bool debug_types = getenv("SHOW_TYPES") != nullptr;
 bool debug_all_expr_types = getenv("SHOW_EXPR_TYPES") != nullptr;
 bool debug_all_translated_defns = getenv("SHOW_DEFN_TYPES") != nullptr;
+bool debug_merge_functions = getenv("SHOW_MERGEFUNC") != nullptr;
+bool debug_global_init = getenv("SHOW_GLOBAL_INIT") != nullptr;
+bool merge_functions = getenv("ZION_NO_MERGEFUNC") == nullptr;
 
 int run_program(std::string executable, std::vector<std::string> args) {
   pid_t pid = fork();
@@ -1088,19 +1091,31 @@ Phase3 specialize(const Phase2 &phase_2) {
   return Phase3{phase_2, translation_map};
 }
 
+/* the specialized definition an LLVM function was generated for */
+struct FunctionOrigin {
+  std::string name;
+  types::Ref type;
+};
+
+/* keyed by LLVM function name */
+typedef std::map<std::string, FunctionOrigin> FunctionOrigins;
+
 struct Phase4 {
   Phase4(const Phase4 &) = delete;
   Phase4(Phase3 phase_3,
          gen::GenEnv &&gen_env,
          llvm::Module *llvm_module,
-         std::string output_llvm_filename)
+         std::string output_llvm_filename,
+         FunctionOrigins &&function_origins)
       : phase_3(phase_3), gen_env(std::move(gen_env)), llvm_module(llvm_module),
-        output_llvm_filename(output_llvm_filename) {
+        output_llvm_filename(output_llvm_filename),
+        function_origins(std::move(function_origins)) {
   }
   Phase4(Phase4 &&rhs)
       : phase_3(rhs.phase_3), gen_env(std::move(rhs.gen_env)),
         llvm_module(rhs.llvm_module),
-        output_llvm_filename(rhs.output_llvm_filename) {
+        output_llvm_filename(rhs.output_llvm_filename),
+        function_origins(std::move(rhs.function_origins)) {
     rhs.llvm_module = nullptr;
   }
   ~Phase4() {
@@ -1112,6 +1127,7 @@ struct Phase4 {
   gen::GenEnv gen_env;
   llvm::Module *llvm_module = nullptr;
   std::string output_llvm_filename;
+  FunctionOrigins function_origins;
 
   std::ostream &dump(std::ostream &os) {
     return os << llvm_print_module(*llvm_module);
@@ -1205,11 +1221,29 @@ void write_main_block(llvm::IRBuilder<> &builder,
   builder.CreateRet(builder.getInt32(0));
 }
 
+void claim_function_origins(llvm::Module *llvm_module,
+                            llvm::Function *llvm_last_function,
+                            std::string name,
+                            types::Ref type,
+                            FunctionOrigins &function_origins) {
+  /* functions are appended to the module as they are created. resolution is
+   * depth-first, so any function defined after llvm_last_function that a
+   * nested resolution has not already claimed belongs to this definition. */
+  auto iter = llvm_last_function->getIterator();
+  for (++iter; iter != llvm_module->end(); ++iter) {
+    std::string function_name = iter->getName().str();
+    if (!iter->isDeclaration() && !in(function_name, function_origins)) {
+      function_origins.insert({function_name, FunctionOrigin{name, type}});
+    }
+  }
+}
+
 Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
   llvm::Module *llvm_module = new llvm::Module("program", context);
   llvm::IRBuilder<> builder(context);
 
   gen::GenEnv gen_env;
+  FunctionOrigins function_origins;
   std::string output_filename;
 
   try {
@@ -1224,6 +1258,19 @@ Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
     debug_above(6, log("globals are %s", join(globals).c_str()));
     debug_above(2, log("type_env is %s",
                        str(phase_3.phase_2.compilation->type_env).c_str()));
+
+    gen::DefinitionLookup lookup_definition =
+        [&phase_3](std::string name, types::Ref type) -> const Translation * {
+      auto iter = phase_3.translation_map.find(name);
+      if (iter == phase_3.translation_map.end()) {
+        return nullptr;
+      }
+      auto iter_type = iter->second.find(types::unitize(type));
+      if (iter_type == iter->second.end()) {
+        return nullptr;
+      }
+      return iter_type->second.get();
+    };
     for (auto pair : phase_3.translation_map) {
       for (auto &overload : pair.second) {
         const std::string &name = pair.first;
@@ -1262,8 +1309,9 @@ Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
 
         std::shared_ptr<gen::Resolver> resolver = gen::lazy_resolver(
             name, type,
-            [&builder, &llvm_module, name, translation, &phase_3, &gen_env,
-             &globals, llvm_main_function](
+            [&builder, &llvm_module, name, type, translation, &phase_3,
+             &gen_env, &function_origins, &lookup_definition, &globals,
+             llvm_main_function](
                 llvm::Value **llvm_value) -> gen::ResolutionStatus {
               gen::Publishable publishable(name, llvm_value);
               /* we are resolving a global object, so we should not be inside
@@ -1276,12 +1324,30 @@ Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
               assert(llvm_entry_terminator);
               builder.SetInsertPoint(llvm_entry_terminator);
 
-              switch (gen::gen(
-                  name, builder, llvm_module, nullptr /*defer_guard*/,
-                  nullptr /*break_to_block*/, nullptr /*continue_to_block*/,
-                  translation->expr, translation->typing,
-                  phase_3.phase_2.compilation->type_env, gen_env, {}, globals,
-                  &publishable)) {
+              llvm::Function *llvm_last_function =
+                  &llvm_module->getFunctionList().back();
+              gen::ResolutionStatus resolution_status;
+              if (llvm::Constant *llvm_constant = gen::gen_constant(
+                      builder, llvm_module, translation->expr,
+                      translation->typing,
+                      phase_3.phase_2.compilation->type_env, gen_env,
+                      lookup_definition)) {
+                /* this global is static data, there is nothing to do at
+                 * startup */
+                publishable.publish(llvm_constant);
+                resolution_status = gen::rs_cache_resolution;
+              } else {
+                resolution_status = gen::gen(
+                    name, builder, llvm_module, nullptr /*defer_guard*/,
+                    nullptr /*break_to_block*/, nullptr /*continue_to_block*/,
+                    translation->expr, translation->typing,
+                    phase_3.phase_2.compilation->type_env, gen_env, {},
+                    globals, &publishable);
+              }
+              claim_function_origins(llvm_module, llvm_last_function, name,
+                                     type, function_origins);
+
+              switch (resolution_status) {
               case gen::rs_resolve_again:
                 return gen::rs_resolve_again;
               case gen::rs_cache_global_load:
@@ -1315,6 +1381,11 @@ Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
 
                       /* initialize the global */
                       builder.CreateStore((*llvm_value), llvm_global);
+                      if (debug_global_init) {
+                        log_location(translation->get_location(),
+                                     "%s :: %s is initialized at startup",
+                                     name.c_str(), type->str().c_str());
+                      }
 
                       *llvm_value = llvm_global;
                       return gen::rs_cache_global_load;
@@ -1353,6 +1424,22 @@ Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
 
     llvm_verify_module(*llvm_module);
 
+    if (merge_functions) {
+      /* specialization emits a separate function for every type a generic
+       * function is used at. most of those only ever deal in pointers, so
+       * their code comes out identical. fold them back together. */
+      LLVMModuleSize before = llvm_get_module_size(*llvm_module);
+      llvm_merge_functions(*llvm_module);
+      llvm_verify_module(*llvm_module);
+      if (debug_merge_functions) {
+        LLVMModuleSize after = llvm_get_module_size(*llvm_module);
+        log("mergefunc: %d functions (%d instructions) -> %d functions (%d "
+            "instructions), saved %d instructions",
+            before.functions, before.instructions, after.functions,
+            after.instructions, before.instructions - after.instructions);
+      }
+    }
+
     std::ofstream ofs;
     ofs.open(output_filename.c_str(), std::ofstream::out);
     ofs << llvm_print_module(*llvm_module) << std::endl;
@@ -1363,7 +1450,8 @@ Phase4 ssa_gen(llvm::LLVMContext &context, const Phase3 &phase_3) {
     /* and continue */
   }
 
-  return Phase4(phase_3, std::move(gen_env), llvm_module, output_filename);
+  return Phase4(phase_3, std::move(gen_env), llvm_module, output_filename,
+                std::move(function_origins));
 }
 
 struct Job {
@@ -1372,15 +1460,137 @@ struct Job {
   std::vector<std::string> args;
 };
 
+std::map<std::string, int> get_symbol_sizes(std::string binary_filename) {
+  /* ask nm for the size of every symbol in the linked binary */
+  std::map<std::string, int> symbol_sizes;
+  auto output = shell_get_output("nm -S --defined-only \"" + binary_filename +
+                                     "\"",
+                                 false /*redirect_to_stdout*/);
+  if (output.first != 0) {
+    log("unable to read symbol sizes from %s", binary_filename.c_str());
+    return symbol_sizes;
+  }
+
+  std::istringstream iss(output.second);
+  std::string line;
+  while (std::getline(iss, line)) {
+    std::istringstream line_iss(line);
+    std::string address, size, kind, symbol;
+    if (line_iss >> address >> size >> kind >> symbol) {
+#ifdef __APPLE__
+      if (starts_with(symbol, "_")) {
+        symbol = symbol.substr(1);
+      }
+#endif
+      symbol_sizes[symbol] += std::stoi(size, nullptr, 16);
+    }
+  }
+  return symbol_sizes;
+}
+
+struct SpecializationSize {
+  std::string type;
+  int functions = 0;
+  int instructions = 0;
+  /* -1 when the code was inlined or merged away */
+  int bytes = -1;
+};
+
+struct OriginSize {
+  std::string name;
+  int instructions = 0;
+  int bytes = 0;
+  std::map<std::string, SpecializationSize> specializations;
+};
+
+void write_size_report(std::ostream &os,
+                       const Phase4 &phase_4,
+                       std::string binary_filename) {
+  std::map<std::string, int> symbol_sizes = get_symbol_sizes(binary_filename);
+
+  /* attribute every function we generated to its specialization, and group
+   * the specializations by the definition they came from */
+  std::map<std::string, OriginSize> origin_sizes;
+  for (auto &pair : phase_4.function_origins) {
+    const FunctionOrigin &origin = pair.second;
+    OriginSize &origin_size = origin_sizes[origin.name];
+    origin_size.name = origin.name;
+
+    std::string type = origin.type->str();
+    SpecializationSize &specialization_size =
+        origin_size.specializations[type];
+    specialization_size.type = type;
+
+    llvm::Function *llvm_function = phase_4.llvm_module->getFunction(
+        pair.first);
+    if (llvm_function == nullptr) {
+      /* mergefunc folded this one into another specialization */
+      continue;
+    }
+    ++specialization_size.functions;
+    specialization_size.instructions += llvm_function->getInstructionCount();
+    origin_size.instructions += llvm_function->getInstructionCount();
+
+    auto symbol_size = symbol_sizes.find(pair.first);
+    if (symbol_size != symbol_sizes.end()) {
+      specialization_size.bytes = std::max(specialization_size.bytes, 0) +
+                                  symbol_size->second;
+      origin_size.bytes += symbol_size->second;
+    }
+  }
+
+  std::vector<const OriginSize *> sorted_origin_sizes;
+  for (auto &pair : origin_sizes) {
+    sorted_origin_sizes.push_back(&pair.second);
+  }
+  std::sort(sorted_origin_sizes.begin(), sorted_origin_sizes.end(),
+            [](const OriginSize *a, const OriginSize *b) {
+              return a->bytes != b->bytes ? a->bytes > b->bytes
+                                          : a->instructions > b->instructions;
+            });
+
+  int total_bytes = 0;
+  int total_instructions = 0;
+  for (auto origin_size : sorted_origin_sizes) {
+    total_bytes += origin_size->bytes;
+    total_instructions += origin_size->instructions;
+  }
+
+  os << "size report for " << binary_filename << ": "
+     << phase_4.function_origins.size() << " functions, " << total_instructions
+     << " instructions, " << total_bytes << " bytes" << std::endl;
+  for (auto origin_size : sorted_origin_sizes) {
+    os << origin_size->name << ": " << origin_size->specializations.size()
+       << " specializations, " << origin_size->instructions
+       << " instructions, " << origin_size->bytes << " bytes" << std::endl;
+    for (auto &pair : origin_size->specializations) {
+      const SpecializationSize &specialization_size = pair.second;
+      os << "\t" << specialization_size.type << ": ";
+      if (specialization_size.functions == 0) {
+        os << "merged" << std::endl;
+        continue;
+      }
+      os << specialization_size.instructions << " instructions, ";
+      if (specialization_size.bytes == -1) {
+        os << "inlined" << std::endl;
+      } else {
+        os << specialization_size.bytes << " bytes" << std::endl;
+      }
+    }
+  }
+}
+
 bool build_binary(const Job &job, bool explain, std::string &program_name) {
   if (explain) {
     std::cout << "build: compiles, specializes, generates LLVM output, then "
-                 "links a binary executable"
+                 "links a binary executable (-size-report lists code size per "
+                 "specialization)"
               << std::endl;
     return false;
   }
 
   bool graph_deps = in_vector("-graph", job.opts);
+  bool size_report = in_vector("-size-report", job.opts);
 
   llvm::LLVMContext context;
   Phase4 phase_4 = ssa_gen(context,
@@ -1452,6 +1662,9 @@ bool build_binary(const Job &job, bool explain, std::string &program_name) {
     throw user_error(INTERNAL_LOC(), "failed to compile binary");
   }
   program_name = phase_4.phase_3.phase_2.compilation->program_name;
+  if (size_report) {
+    write_size_report(std::cout, phase_4, program_name);
+  }
   return true;
 }
 
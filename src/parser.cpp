@@ -583,8 +583,62 @@ const Expr *parse_base_expr(ParseState &ps) {
   }
 }
 
+bool is_static_array_literal(const std::vector<const Expr *> &exprs) {
+  /* can these exprs be laid out as an array at compile time? */
+  if (exprs.size() == 0) {
+    return false;
+  }
+  for (auto expr : exprs) {
+    auto literal = dcast<const Literal *>(expr);
+    if (literal == nullptr) {
+      return false;
+    }
+    switch (literal->token.tk) {
+    case tk_integer:
+    case tk_float:
+    case tk_char:
+      break;
+    default:
+      return false;
+    }
+    if (literal->token.tk != static_cast<const Literal *>(exprs[0])->token.tk) {
+      return false;
+    }
+  }
+  return true;
+}
+
 const Expr *build_array_literal(Location location,
                                 const std::vector<const Expr *> &exprs) {
+  if (is_static_array_literal(exprs)) {
+    /* all the elements are known at compile time, so keep them in static
+     * memory and copy them into the new vector in one go. the builtin's
+     * scheme does not relate the tuple to the pointer it returns, so pin the
+     * element type down here, from the kind of literal. */
+    std::string element_type;
+    switch (static_cast<const Literal *>(exprs[0])->token.tk) {
+    case tk_integer:
+      element_type = INT_TYPE;
+      break;
+    case tk_float:
+      element_type = FLOAT_TYPE;
+      break;
+    default:
+      element_type = CHAR_TYPE;
+      break;
+    }
+    return new Application(
+        new Var(Identifier{tld::mktld("vector", "vector_from_static"),
+                           location}),
+        {new As(new Builtin(new Var(Identifier{"__builtin_static_array",
+                                               location}),
+                            {new Tuple(location, exprs)}),
+                type_ptr(type_id(make_iid(element_type))),
+                false /*force_cast*/),
+         new Literal(
+             Token{location, tk_integer, std::to_string(exprs.size())})});
+  }
+
   auto array_var = new Var(Identifier(fresh(), location));
 
   /* take all the exprs from the array, and turn them into statements to fill
@@ -886,6 +940,103 @@ const Expr *parse_string_expr_suffix(const Token &token) {
   }
 }
 
+const Application *as_string_literal(const Expr *expr) {
+  /* recognize the String(sz, len) built by parse_string_literal */
+  auto application = dcast<const Application *>(expr);
+  if (application == nullptr || application->params.size() != 2) {
+    return nullptr;
+  }
+  auto ctor = dcast<const Var *>(application->a);
+  if (ctor == nullptr || ctor->id.name != STRING_TYPE ||
+      dcast<const Literal *>(application->params[0]) == nullptr ||
+      dcast<const Literal *>(application->params[1]) == nullptr) {
+    return nullptr;
+  }
+  return application;
+}
+
+const Expr *build_string_interpolation(Location location,
+                                       const std::vector<const Expr *> &exprs) {
+  /* lower the fragments of an interpolated string into a single allocation:
+   *
+   *   let s1 = str(x) in ...
+   *   let buf = alloc_string_buffer(<literal lengths> + len(s1) + ...) in
+   *   let o1 = write_chars(buf, 0, "literal", 7) in
+   *   let o2 = write_string(buf, o1, s1) in
+   *   ...
+   *   String(buf, oN) */
+  std::vector<const Expr *> pieces;
+  std::vector<Identifier> piece_ids;
+  int literal_length = 0;
+  for (auto expr : exprs) {
+    if (auto literal = as_string_literal(expr)) {
+      literal_length += parse_int_value(
+          static_cast<const Literal *>(literal->params[1])->token);
+      pieces.push_back(literal);
+      piece_ids.push_back(Identifier{"", expr->get_location()});
+    } else {
+      pieces.push_back(expr);
+      piece_ids.push_back(Identifier{fresh(), expr->get_location()});
+    }
+  }
+
+  Identifier buf_id{fresh(), location};
+  std::vector<Identifier> offset_ids;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    offset_ids.push_back(Identifier{fresh(), location});
+  }
+
+  /* build from the inside out */
+  const Expr *body = new Application(
+      new Var(Identifier{STRING_TYPE, location}),
+      {new Var(buf_id), new Var(offset_ids.back())});
+
+  for (int i = pieces.size() - 1; i >= 0; --i) {
+    const Expr *offset = (i == 0) ? static_cast<const Expr *>(new Literal(
+                                        Token{location, tk_integer, "0"}))
+                                  : new Var(offset_ids[i - 1]);
+    const Expr *write;
+    if (auto literal = as_string_literal(pieces[i])) {
+      write = new Application(
+          new Var(Identifier{tld::mktld("string", "write_chars"), location}),
+          {new Var(buf_id), offset, literal->params[0], literal->params[1]});
+    } else {
+      write = new Application(
+          new Var(Identifier{tld::mktld("string", "write_string"), location}),
+          {new Var(buf_id), offset, new Var(piece_ids[i])});
+    }
+    body = new Let(offset_ids[i], write, body);
+  }
+
+  const Expr *total_length = new Literal(
+      Token{location, tk_integer, std::to_string(literal_length)});
+  for (auto &piece_id : piece_ids) {
+    if (piece_id.name != "") {
+      total_length = new Application(
+          new Var(Identifier{tld::mktld("std", "+"), location}),
+          {total_length,
+           new Application(
+               new Var(Identifier{tld::mktld("std", "len"), location}),
+               {new Var(piece_id)})});
+    }
+  }
+  body = new Let(
+      buf_id,
+      new Application(new Var(Identifier{
+                          tld::mktld("string", "alloc_string_buffer"),
+                          location}),
+                      {total_length}),
+      body);
+
+  /* evaluate the interpolated expressions first, in order */
+  for (int i = pieces.size() - 1; i >= 0; --i) {
+    if (piece_ids[i].name != "") {
+      body = new Let(piece_ids[i], pieces[i], body);
+    }
+  }
+  return body;
+}
+
 const Expr *parse_string_expr(ParseState &ps) {
   /* parse string interpolation like "x = ${x}, y = ${y}, x + y = ${x + y}" */
   assert(ps.token.tk == tk_string_expr_prefix);
@@ -928,14 +1079,7 @@ const Expr *parse_string_expr(ParseState &ps) {
     /* don't bother joining if it's just a single expr in a string */
     return exprs[0];
   } else {
-    /* for now, just call join on all of these exprs, after ensuring that they
-     * are stringified. */
-    const Expr *str_array = build_array_literal(location, exprs);
-    return new Application(
-        new Var(ps.id_mapped(Identifier{"join", location})),
-        {parse_string_literal(Token{location, tk_string, "\"\""},
-                              nullptr /*typing*/),
-         str_array});
+    return build_string_interpolation(location, exprs);
   }
 }
 
@@ -2076,7 +2220,8 @@ std::pair<Identifier, types::Ref> parse_lambda_param_core(ParseState &ps) {
 
 const Expr *parse_lambda(ParseState &ps,
                          std::string start_param_list,
-                         std::string end_param_list) {
+                         std::string end_param_list,
+                         int attributes) {
   if (ps.token.tk == tk_identifier) {
     throw user_error(ps.token.location, "identifiers are unexpected here");
   }
@@ -2109,7 +2254,37 @@ const Expr *parse_lambda(ParseState &ps,
   }
 
   return new Lambda(param_ids, param_types, return_type,
-                    parse_block(ps, true /*expression_means_return*/));
+                    parse_block(ps, true /*expression_means_return*/),
+                    attributes);
+}
+
+int parse_function_attributes(ParseState &ps) {
+  /* parse any optimization hints preceding a function declaration, as in
+   *
+   *   inline fn hash(x) => ...
+   *   cold fn fail(message) => ...
+   */
+  int attributes = 0;
+  while (ps.token.tk == tk_identifier &&
+         is_function_attribute(ps.token.text)) {
+    FunctionAttribute attribute = get_function_attribute(ps.token.location,
+                                                         ps.token.text);
+    if (attributes & attribute) {
+      throw user_error(ps.token.location, "duplicate function attribute %s",
+                       ps.token.text.c_str());
+    }
+    attributes |= attribute;
+    if ((attributes & fa_inline) && (attributes & fa_noinline)) {
+      throw user_error(ps.token.location,
+                       "a function cannot be both inline and noinline");
+    }
+    if ((attributes & fa_hot) && (attributes & fa_cold)) {
+      throw user_error(ps.token.location,
+                       "a function cannot be both hot and cold");
+    }
+    ps.advance();
+  }
+  return attributes;
 }
 
 types::Ref parse_function_type(ParseState &ps) {
@@ -2594,6 +2769,25 @@ std::vector<const Decl *> parse_decls(ParseState &ps) {
       auto token = ps.token_and_advance();
       auto id = ps.id_mapped(Identifier{token.text, token.location});
       decls.push_back(new Decl(id, parse_lambda(ps)));
+    } else if (ps.token.tk == tk_identifier &&
+               is_function_attribute(ps.token.text)) {
+      /* instance-level functions with attributes. note that an attribute name
+       * is only an attribute when it is followed by fn, otherwise it is the
+       * name of an instance-level let var. */
+      auto attribute_token = ps.token;
+      int attributes = parse_function_attributes(ps);
+      if (ps.token.is_ident(K(fn))) {
+        ps.advance();
+        auto token = ps.token_and_advance();
+        auto id = ps.id_mapped(Identifier{token.text, token.location});
+        decls.push_back(new Decl(id, parse_lambda(ps, "(", ")", attributes)));
+      } else {
+        auto id = ps.id_mapped(
+            Identifier{attribute_token.text, attribute_token.location});
+        chomp_operator("=");
+        decls.push_back(
+            new Decl(id, parse_expr(ps, false /*allow_for_comprehensions*/)));
+      }
     } else if (ps.token.tk != tk_rcurly) {
       /* instance-level let vars */
       auto name_token = ps.token_and_advance();
@@ -2905,12 +3099,15 @@ const Module *parse_module(ParseState &ps,
                        "import statements must occur at the top of the module");
     } else if (ps.token.tk == tk_identifier && ps.token.text == "export") {
       throw user_error(ps.token.location, "export statements are deprecated");
-    } else if (ps.token.is_ident(K(fn))) {
+    } else if (ps.token.is_ident(K(fn)) ||
+               (ps.token.tk == tk_identifier &&
+                is_function_attribute(ps.token.text))) {
       /* module-level functions */
-      ps.advance();
+      int attributes = parse_function_attributes(ps);
+      chomp_ident(K(fn));
       Token token = ps.token_and_advance();
       auto id = Identifier(token.text, token.location);
-      decls.push_back(new Decl(id, parse_lambda(ps)));
+      decls.push_back(new Decl(id, parse_lambda(ps, "(", ")", attributes)));
       ps.export_symbol(id, ps.mkfqn(id));
     } else if (ps.token.is_ident(K(struct))) {
       ps.advance();
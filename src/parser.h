@@ -110,7 +110,9 @@ const ast::While *parse_while(ParseState &ps);
 const ast::Expr *parse_string_literal(const Token &token, TrackedTypes *typing);
 const ast::Expr *parse_lambda(ParseState &ps,
                               std::string start_param_list = "(",
-                              std::string end_param_list = ")");
+                              std::string end_param_list = ")",
+                              int attributes = 0);
+int parse_function_attributes(ParseState &ps);
 const ast::Match *parse_match(ParseState &ps);
 const ast::Predicate *parse_predicate(ParseState &ps,
                                       bool allow_else,
@@ -197,7 +197,8 @@ const Expr *prefix(const std::set<std::string> &bindings,
     return new Lambda(
         lambda->vars, prefix(bindings, pre, lambda->param_types),
         prefix(bindings, pre, lambda->return_type),
-        prefix(without(bindings, lambda->vars), pre, lambda->body));
+        prefix(without(bindings, lambda->vars), pre, lambda->body),
+        lambda->attributes);
   } else if (auto let = dcast<const Let *>(value)) {
     return new Let(let->var,
                    prefix(::without(bindings, let->var.name), pre, let->value),
@@ -128,7 +128,8 @@ const Expr *texpr(const types::DefnId &for_defn_id,
                        lambda_terms.back()->str().c_str());
         throw error;
       }
-      auto new_lambda = new Lambda(lambda->vars, {}, nullptr, new_body);
+      auto new_lambda = new Lambda(lambda->vars, {}, nullptr, new_body,
+                                   lambda->attributes);
       typing[new_lambda] = type;
       return new_lambda;
     } else if (auto application = dcast<const Application *>(expr)) {